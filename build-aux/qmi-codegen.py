@@ -0,0 +1,681 @@
+#!/usr/bin/env python
+# -*- Mode: python; tab-width: 4; indent-tabs-mode: nil -*-
+#
+# libqmi-glib -- GLib/GIO based library to control QMI devices
+#
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the
+# Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+# Boston, MA 02110-1301 USA.
+#
+# Copyright (C) 2012 Aleksander Morgado <aleksander@lanedo.com>
+#
+
+#
+# Generates the message handling code of a QMI service from its JSON
+# description:
+#
+#  * The definitions of the opaque Input and Output types.
+#  * new()/ref()/unref() for the Input types, and get_result()/ref()/unref()
+#    for the Output types.
+#  * The request builders, qmi_message_<service>_<message>_new().
+#  * The reply parsers, qmi_message_<service>_<message>_reply_parse(), which
+#    walk the TLVs of the reply just once, dispatching them by type.
+#
+# Getters and setters of the specific fields are not generated, as they
+# usually need some logic of their own.
+#
+# Usage: qmi-codegen.py --input FILE --output-prefix PREFIX
+#
+
+import json
+import optparse
+import os
+import re
+import sys
+
+# Fixed-size formats: C type, size in bytes and reader
+FORMATS = {
+    'guint8'  : ('guint8',  1, '{buffer}[{offset}]'),
+    'gint8'   : ('gint8',   1, '(gint8){buffer}[{offset}]'),
+    'guint16' : ('guint16', 2, 'read_guint16 (&{buffer}[{offset}])'),
+    'guint32' : ('guint32', 4, 'read_guint32 (&{buffer}[{offset}])'),
+}
+
+HEADER = '''/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/* GENERATED FILE: do not edit, generated by qmi-codegen.py from {input} */
+
+'''
+
+
+def underscore (name):
+    return re.sub ('[^a-z0-9]+', '_', name.lower ()).strip ('_')
+
+
+def camelcase (name):
+    return ''.join ([word[0].upper () + word[1:].lower () for word in name.split ()])
+
+
+class Field:
+    def __init__ (self, service, message, prefix, data):
+        self.name = data['name']
+        self.underscore = underscore (self.name)
+        self.id = data['id']
+        self.format = data['format']
+        self.mandatory = data.get ('mandatory', False)
+        self.nonzero = data.get ('nonzero', False)
+        self.nul_terminated = data.get ('nul-terminated', False)
+        self.default = data.get ('default', None)
+        self.only_on_error = data.get ('only-on-error', None)
+        self.tlv = '%s_%s_TLV_%s' % (message.upper, prefix, self.underscore.upper ())
+        self.contents = []
+        if self.format == 'struct':
+            for member in data['contents']:
+                if member['format'] not in FORMATS:
+                    raise ValueError ('Unsupported struct member format: %s' % member['format'])
+                self.contents.append ((underscore (member['name']), member['format']))
+        elif self.format != 'string' and self.format not in FORMATS:
+            raise ValueError ('Unsupported format: %s' % self.format)
+
+    def size (self):
+        if self.format == 'struct':
+            return sum ([FORMATS[fmt][1] for (name, fmt) in self.contents])
+        return FORMATS[self.format][1]
+
+    def emit_struct_members (self, f):
+        if self.format == 'string':
+            f.write ('    gchar *%s;\n' % self.underscore)
+            return
+        f.write ('    gboolean %s_set;\n' % self.underscore)
+        if self.format == 'struct':
+            f.write ('    struct {\n')
+            for (name, fmt) in self.contents:
+                f.write ('        %s %s;\n' % (FORMATS[fmt][0], name))
+            f.write ('    } %s;\n' % self.underscore)
+        else:
+            f.write ('    %s %s;\n' % (FORMATS[self.format][0], self.underscore))
+
+
+class Message:
+    def __init__ (self, service, data):
+        self.service = service
+        self.name = data['name']
+        self.id = data['id']
+        self.underscore = underscore (self.name)
+        self.upper = self.underscore.upper ()
+        self.camelcase = camelcase (self.name)
+        self.has_input = 'input' in data
+        self.has_output = 'output' in data
+        self.input = [Field (service, self, 'INPUT', field) for field in data.get ('input', [])]
+        self.output = [Field (service, self, 'OUTPUT', field) for field in data.get ('output', [])]
+        self.input_type = 'Qmi%s%sInput' % (service.camelcase, self.camelcase)
+        self.output_type = 'Qmi%s%sOutput' % (service.camelcase, self.camelcase)
+        self.input_prefix = 'qmi_%s_%s_input' % (service.underscore, self.underscore)
+        self.output_prefix = 'qmi_%s_%s_output' % (service.underscore, self.underscore)
+        self.message_prefix = 'qmi_message_%s_%s' % (service.underscore, self.underscore)
+
+    # Header: TLV ids and opaque types
+
+    def emit_header (self, f):
+        f.write ('/*****************************************************************************/\n'
+                 '/* %s */\n\n' % self.name)
+
+        if self.input or self.output:
+            f.write ('enum {\n')
+            tlvs = ['    %s = %s' % (field.tlv, field.id) for field in self.input + self.output]
+            f.write (',\n'.join (tlvs))
+            f.write ('\n};\n\n')
+
+        if self.has_input:
+            f.write ('/**\n'
+                     ' * %s:\n'
+                     ' *\n'
+                     ' * An opaque type handling the input arguments that may be passed to the %s\n'
+                     ' * operation in the %s service.\n'
+                     ' */\n' % (self.input_type, self.name, self.service.name))
+            f.write ('struct _%s {\n'
+                     '    volatile gint ref_count;\n' % self.input_type)
+            for field in self.input:
+                field.emit_struct_members (f)
+            f.write ('};\n\n')
+
+        if self.has_output:
+            f.write ('/**\n'
+                     ' * %s:\n'
+                     ' *\n'
+                     ' * An opaque type handling the output of the %s operation.\n'
+                     ' */\n' % (self.output_type, self.name))
+            f.write ('struct _%s {\n'
+                     '    volatile gint ref_count;\n'
+                     '    GError *error;\n' % self.output_type)
+            for field in self.output:
+                field.emit_struct_members (f)
+            f.write ('};\n\n')
+
+    # Source: Input type
+
+    def emit_input (self, f):
+        f.write ('/**\n'
+                 ' * %(prefix)s_new:\n'
+                 ' *\n'
+                 ' * Allocates a new #%(type)s.\n'
+                 ' *\n'
+                 ' * Returns: the newly created #%(type)s.\n'
+                 ' */\n'
+                 '%(type)s *\n'
+                 '%(prefix)s_new (void)\n'
+                 '{\n'
+                 '    %(type)s *input;\n'
+                 '\n'
+                 '    input = g_slice_new0 (%(type)s);\n'
+                 '    input->ref_count = 1;\n'
+                 '    return input;\n'
+                 '}\n\n' % { 'type' : self.input_type, 'prefix' : self.input_prefix })
+
+        f.write ('/**\n'
+                 ' * %(prefix)s_ref:\n'
+                 ' * @input: a #%(type)s.\n'
+                 ' *\n'
+                 ' * Atomically increments the reference count of @input by one.\n'
+                 ' *\n'
+                 ' * Returns: the new reference to @input.\n'
+                 ' */\n'
+                 '%(type)s *\n'
+                 '%(prefix)s_ref (%(type)s *input)\n'
+                 '{\n'
+                 '    g_return_val_if_fail (input != NULL, NULL);\n'
+                 '\n'
+                 '    g_atomic_int_inc (&input->ref_count);\n'
+                 '    return input;\n'
+                 '}\n\n' % { 'type' : self.input_type, 'prefix' : self.input_prefix })
+
+        f.write ('/**\n'
+                 ' * %(prefix)s_unref:\n'
+                 ' * @input: a #%(type)s.\n'
+                 ' *\n'
+                 ' * Atomically decrements the reference count of @input by one.\n'
+                 ' * If the reference count drops to 0, @input is completely disposed.\n'
+                 ' */\n'
+                 'void\n'
+                 '%(prefix)s_unref (%(type)s *input)\n'
+                 '{\n'
+                 '    g_return_if_fail (input != NULL);\n'
+                 '\n'
+                 '    if (g_atomic_int_dec_and_test (&input->ref_count)) {\n' % { 'type' : self.input_type, 'prefix' : self.input_prefix })
+        for field in self.input:
+            if field.format == 'string':
+                f.write ('        g_free (input->%s);\n' % field.underscore)
+        f.write ('        g_slice_free (%s, input);\n'
+                 '    }\n'
+                 '}\n\n' % self.input_type)
+
+    # Source: request builder
+
+    def emit_builder (self, f):
+        if self.has_input:
+            f.write ('QmiMessage *\n'
+                     '%s_new (guint8 transaction_id,\n'
+                     '%s      guint8 client_id,\n'
+                     '%s      %s *input,\n'
+                     '%s      GError **error)\n'
+                     '{\n'
+                     '    QmiMessageBuilder *builder;\n'
+                     '    QmiMessage *message;\n'
+                     '    gsize size_hint = 0;\n'
+                     '\n' % (self.message_prefix,
+                             ' ' * len (self.message_prefix),
+                             ' ' * len (self.message_prefix), self.input_type,
+                             ' ' * len (self.message_prefix)))
+        else:
+            f.write ('QmiMessage *\n'
+                     '%s_new (guint8 transaction_id,\n'
+                     '%s      guint8 client_id)\n'
+                     '{\n'
+                     '    QmiMessage *message;\n'
+                     '    GError *error = NULL;\n'
+                     '\n'
+                     '    message = qmi_message_builder_finish (\n'
+                     '        qmi_message_builder_new (QMI_SERVICE_%s,\n'
+                     '                                 client_id,\n'
+                     '                                 transaction_id,\n'
+                     '                                 %s,\n'
+                     '                                 0),\n'
+                     '        &error);\n'
+                     '    g_assert_no_error (error);\n'
+                     '\n'
+                     '    return message;\n'
+                     '}\n\n' % (self.message_prefix,
+                                ' ' * len (self.message_prefix),
+                                self.service.upper,
+                                self.id))
+            return
+
+        # Check mandatory input arguments
+        for field in self.input:
+            if not field.mandatory:
+                continue
+            if field.format == 'string':
+                is_set = 'input->%s' % field.underscore
+            else:
+                is_set = 'input->%s_set' % field.underscore
+            f.write ('    if (!input || !%s) {\n'
+                     '        g_set_error (error,\n'
+                     '                     QMI_CORE_ERROR,\n'
+                     '                     QMI_CORE_ERROR_INVALID_ARGS,\n'
+                     '                     "Missing mandatory argument \'%s\'");\n'
+                     '        return NULL;\n'
+                     '    }\n'
+                     '\n' % (is_set, field.name.lower ()))
+            if field.nonzero:
+                f.write ('    if (!input->%s) {\n'
+                         '        g_set_error (error,\n'
+                         '                     QMI_CORE_ERROR,\n'
+                         '                     QMI_CORE_ERROR_INVALID_ARGS,\n'
+                         '                     "Invalid \'%s\': %%u",\n'
+                         '                     (guint)input->%s);\n'
+                         '        return NULL;\n'
+                         '    }\n'
+                         '\n' % (field.underscore, field.name.lower (), field.underscore))
+
+        # Size all TLVs upfront, so that the builder allocates just once
+        f.write ('    if (input) {\n')
+        for field in self.input:
+            if field.format == 'string':
+                f.write ('        if (input->%s)\n'
+                         '            size_hint += 3 + strlen (input->%s)%s;\n'
+                         % (field.underscore, field.underscore, ' + 1' if field.nul_terminated else ''))
+            else:
+                f.write ('        if (input->%s_set)\n'
+                         '            size_hint += 3 + %u;\n' % (field.underscore, field.size ()))
+        f.write ('    }\n'
+                 '\n'
+                 '    builder = qmi_message_builder_new (QMI_SERVICE_%s,\n'
+                 '                                       client_id,\n'
+                 '                                       transaction_id,\n'
+                 '                                       %s,\n'
+                 '                                       size_hint);\n'
+                 '\n'
+                 '    if (input) {\n' % (self.service.upper, self.id))
+        for field in self.input:
+            if field.format == 'string':
+                f.write ('        if (input->%s)\n'
+                         '            qmi_message_builder_add_raw (builder,\n'
+                         '                                         %s,\n'
+                         '                                         input->%s,\n'
+                         '                                         strlen (input->%s)%s);\n'
+                         % (field.underscore, field.tlv, field.underscore, field.underscore,
+                            ' + 1' if field.nul_terminated else ''))
+            elif field.format == 'struct':
+                raise ValueError ('Struct input fields are not supported')
+            else:
+                f.write ('        if (input->%s_set)\n'
+                         '            qmi_message_builder_add_u%u (builder,\n'
+                         '                                        %s,\n'
+                         '                                        input->%s);\n'
+                         % (field.underscore, 8 * field.size (), field.tlv, field.underscore))
+        f.write ('    }\n'
+                 '\n'
+                 '    message = qmi_message_builder_finish (builder, error);\n'
+                 '    if (!message)\n'
+                 '        g_prefix_error (error, "Failed to build %s message: ");\n'
+                 '\n'
+                 '    return message;\n'
+                 '}\n\n' % self.name)
+
+    # Source: Output type
+
+    def emit_output (self, f):
+        f.write ('/**\n'
+                 ' * %(prefix)s_get_result:\n'
+                 ' * @output: a #%(type)s.\n'
+                 ' * @error: a #GError.\n'
+                 ' *\n'
+                 ' * Get the result of the %(name)s operation.\n'
+                 ' *\n'
+                 ' * Returns: #TRUE if the operation succeeded, and #FALSE if @error is set.\n'
+                 ' */\n'
+                 'gboolean\n'
+                 '%(prefix)s_get_result (%(type)s *output,\n'
+                 '%(indent)s             GError **error)\n'
+                 '{\n'
+                 '    g_return_val_if_fail (output != NULL, FALSE);\n'
+                 '\n'
+                 '    if (output->error) {\n'
+                 '        if (error)\n'
+                 '            *error = g_error_copy (output->error);\n'
+                 '\n'
+                 '        return FALSE;\n'
+                 '    }\n'
+                 '\n'
+                 '    return TRUE;\n'
+                 '}\n\n' % { 'type' : self.output_type,
+                             'prefix' : self.output_prefix,
+                             'name' : self.name,
+                             'indent' : ' ' * len (self.output_prefix) })
+
+        f.write ('/**\n'
+                 ' * %(prefix)s_ref:\n'
+                 ' * @output: a #%(type)s.\n'
+                 ' *\n'
+                 ' * Atomically increments the reference count of @output by one.\n'
+                 ' *\n'
+                 ' * Returns: the new reference to @output.\n'
+                 ' */\n'
+                 '%(type)s *\n'
+                 '%(prefix)s_ref (%(type)s *output)\n'
+                 '{\n'
+                 '    g_return_val_if_fail (output != NULL, NULL);\n'
+                 '\n'
+                 '    g_atomic_int_inc (&output->ref_count);\n'
+                 '    return output;\n'
+                 '}\n\n' % { 'type' : self.output_type, 'prefix' : self.output_prefix })
+
+        f.write ('/**\n'
+                 ' * %(prefix)s_unref:\n'
+                 ' * @output: a #%(type)s.\n'
+                 ' *\n'
+                 ' * Atomically decrements the reference count of @output by one.\n'
+                 ' * If the reference count drops to 0, @output is completely disposed.\n'
+                 ' */\n'
+                 'void\n'
+                 '%(prefix)s_unref (%(type)s *output)\n'
+                 '{\n'
+                 '    g_return_if_fail (output != NULL);\n'
+                 '\n'
+                 '    if (g_atomic_int_dec_and_test (&output->ref_count)) {\n'
+                 '        if (output->error)\n'
+                 '            g_error_free (output->error);\n' % { 'type' : self.output_type, 'prefix' : self.output_prefix })
+        for field in self.output:
+            if field.format == 'string':
+                f.write ('        g_free (output->%s);\n' % field.underscore)
+        f.write ('        g_slice_free (%s, output);\n'
+                 '    }\n'
+                 '}\n\n' % self.output_type)
+
+    # Source: reply parser
+
+    def emit_parser (self, f):
+        # Per-TLV dispatcher, run once for each TLV in the reply
+        f.write ('static void\n'
+                 '%s_reply_parse_tlv (guint8 type,\n'
+                 '%s                  gsize length,\n'
+                 '%s                  gconstpointer value,\n'
+                 '%s                  gpointer user_data)\n'
+                 '{\n'
+                 '    ReplyParseContext *ctx = user_data;\n'
+                 % (self.underscore,
+                    ' ' * len (self.underscore),
+                    ' ' * len (self.underscore),
+                    ' ' * len (self.underscore)))
+        if self.output:
+            f.write ('    %s *output = ctx->output;\n' % self.output_type)
+        f.write ('    const guint8 *buffer = value;\n'
+                 '\n'
+                 '    switch (type) {\n'
+                 '    case REPLY_TLV_RESULT_CODE:\n'
+                 '        if (length == 4 && !ctx->result_found) {\n'
+                 '            ctx->result_found = TRUE;\n'
+                 '            ctx->result_status = read_guint16 (&buffer[0]);\n'
+                 '            ctx->result_error = read_guint16 (&buffer[2]);\n'
+                 '        }\n'
+                 '        break;\n')
+        for field in self.output:
+            f.write ('    case %s:\n' % field.tlv)
+            if field.format == 'string':
+                f.write ('        if (!output->%s)\n'
+                         '            output->%s = g_strndup ((const gchar *)buffer, length);\n'
+                         % (field.underscore, field.underscore))
+            else:
+                # First TLV of each type wins, as with qmi_message_tlv_get()
+                f.write ('        if (length == %u && !output->%s_set) {\n'
+                         '            output->%s_set = TRUE;\n' % (field.size (), field.underscore, field.underscore))
+                if field.format == 'struct':
+                    offset = 0
+                    for (name, fmt) in field.contents:
+                        f.write ('            output->%s.%s = %s;\n'
+                                 % (field.underscore, name,
+                                    FORMATS[fmt][2].format (buffer = 'buffer', offset = offset)))
+                        offset += FORMATS[fmt][1]
+                else:
+                    f.write ('            output->%s = %s;\n'
+                             % (field.underscore, FORMATS[field.format][2].format (buffer = 'buffer', offset = 0)))
+                f.write ('        }\n')
+            f.write ('        break;\n')
+        f.write ('    default:\n'
+                 '        break;\n'
+                 '    }\n'
+                 '}\n\n')
+
+        f.write ('%(type)s *\n'
+                 '%(prefix)s_reply_parse (QmiMessage *self,\n'
+                 '%(indent)s              GError **error)\n'
+                 '{\n'
+                 '    %(type)s *output;\n'
+                 '    ReplyParseContext ctx;\n'
+                 '\n'
+                 '    g_assert (qmi_message_get_message_id (self) == %(id)s);\n'
+                 '\n'
+                 '    output = g_slice_new0 (%(type)s);\n'
+                 '    output->ref_count = 1;\n'
+                 % { 'type' : self.output_type,
+                     'prefix' : self.message_prefix,
+                     'indent' : ' ' * len (self.message_prefix),
+                     'id' : self.id })
+        for field in self.output:
+            if field.default is None:
+                continue
+            if field.format == 'struct':
+                for (name, fmt) in field.contents:
+                    f.write ('    output->%s.%s = %s;\n' % (field.underscore, name, field.default))
+            else:
+                f.write ('    output->%s = %s;\n' % (field.underscore, field.default))
+        f.write ('\n'
+                 '    /* Walk the TLVs just once */\n'
+                 '    ctx.output = output;\n'
+                 '    ctx.result_found = FALSE;\n'
+                 '    qmi_message_tlv_foreach (self, %s_reply_parse_tlv, &ctx);\n'
+                 '\n'
+                 '    /* Only QMI protocol errors are set in the Output result, all the\n'
+                 '     * others (e.g. failures parsing) are directly propagated to error. */\n'
+                 '    if (!reply_parse_result (self, &ctx, &output->error, error)) {\n'
+                 '        %s_unref (output);\n'
+                 '        return NULL;\n'
+                 '    }\n'
+                 '\n' % (self.underscore, self.output_prefix))
+
+        # TLVs only expected along with a given error are discarded otherwise
+        for field in [field for field in self.output if field.only_on_error]:
+            f.write ('    /* %s is only given on %s errors */\n'
+                     '    if (!output->error ||\n'
+                     '        !g_error_matches (output->error, QMI_PROTOCOL_ERROR, %s)) {\n'
+                     % (field.name, field.only_on_error, field.only_on_error))
+            if field.format == 'string':
+                f.write ('        g_free (output->%s);\n'
+                         '        output->%s = NULL;\n' % (field.underscore, field.underscore))
+            else:
+                f.write ('        output->%s_set = FALSE;\n' % field.underscore)
+                if field.format == 'struct':
+                    for (name, fmt) in field.contents:
+                        f.write ('        output->%s.%s = %s;\n'
+                                 % (field.underscore, name, field.default if field.default is not None else '0'))
+                else:
+                    f.write ('        output->%s = %s;\n'
+                             % (field.underscore, field.default if field.default is not None else '0'))
+            f.write ('    }\n'
+                     '\n')
+
+        mandatory = [field for field in self.output if field.mandatory]
+        if mandatory:
+            f.write ('    /* Mandatory TLVs are only given on success */\n'
+                     '    if (!output->error) {\n')
+            for field in mandatory:
+                if field.format == 'string':
+                    is_set = 'output->%s' % field.underscore
+                else:
+                    is_set = 'output->%s_set' % field.underscore
+                f.write ('        if (!%s) {\n'
+                         '            g_set_error (error,\n'
+                         '                         QMI_CORE_ERROR,\n'
+                         '                         QMI_CORE_ERROR_TLV_NOT_FOUND,\n'
+                         '                         "Couldn\'t get the %s TLV");\n'
+                         '            %s_unref (output);\n'
+                         '            return NULL;\n'
+                         '        }\n' % (is_set, field.name.lower (), self.output_prefix))
+            f.write ('    }\n'
+                     '\n')
+
+        f.write ('    return output;\n'
+                 '}\n\n')
+
+    def emit_source (self, f):
+        f.write ('/*****************************************************************************/\n'
+                 '/* %s */\n\n' % self.name)
+        if self.has_input:
+            self.emit_input (f)
+        self.emit_builder (f)
+        if self.has_output:
+            self.emit_output (f)
+            self.emit_parser (f)
+
+
+class Service:
+    def __init__ (self, data):
+        self.name = data['service']
+        self.underscore = underscore (self.name)
+        self.upper = self.underscore.upper ()
+        self.camelcase = self.name[0].upper () + self.name[1:].lower ()
+        self.messages = [Message (self, message) for message in data['messages']]
+
+
+COMMON_SOURCE = '''/*****************************************************************************/
+/* Common reply parsing helpers */
+
+#define REPLY_TLV_RESULT_CODE 0x02
+
+typedef struct {
+    gpointer output;
+    gboolean result_found;
+    guint16 result_status;
+    guint16 result_error;
+} ReplyParseContext;
+
+/* TLV values are little endian and not aligned */
+static inline guint16
+read_guint16 (const guint8 *buffer)
+{
+    return (guint16)(buffer[0] | (buffer[1] << 8));
+}
+
+static inline guint32
+read_guint32 (const guint8 *buffer)
+{
+    return ((guint32)buffer[0] |
+            ((guint32)buffer[1] << 8) |
+            ((guint32)buffer[2] << 16) |
+            ((guint32)buffer[3] << 24));
+}
+
+static gboolean
+reply_parse_result (QmiMessage *self,
+                    ReplyParseContext *ctx,
+                    GError **protocol_error,
+                    GError **error)
+{
+    GError *inner_error = NULL;
+
+    if (!qmi_message_is_response (self)) {
+        g_set_error (error,
+                     QMI_CORE_ERROR,
+                     QMI_CORE_ERROR_INVALID_MESSAGE,
+                     "Cannot get result code from non-response message");
+        return FALSE;
+    }
+
+    if (!ctx->result_found) {
+        g_set_error (error,
+                     QMI_CORE_ERROR,
+                     QMI_CORE_ERROR_TLV_NOT_FOUND,
+                     "Couldn't get result code: TLV not found");
+        return FALSE;
+    }
+
+    if (!qmi_message_check_result_code (ctx->result_status,
+                                        ctx->result_error,
+                                        &inner_error)) {
+        if (inner_error->domain != QMI_PROTOCOL_ERROR) {
+            g_propagate_error (error, inner_error);
+            return FALSE;
+        }
+        *protocol_error = inner_error;
+    }
+
+    return TRUE;
+}
+
+'''
+
+
+def main ():
+    parser = optparse.OptionParser (usage = '%prog --input FILE --output-prefix PREFIX')
+    parser.add_option ('--input', dest = 'input', help = 'JSON description of the service')
+    parser.add_option ('--output-prefix', dest = 'output_prefix', help = 'Prefix of the generated .c and .h files')
+    (options, args) = parser.parse_args ()
+    if not options.input or not options.output_prefix:
+        parser.error ('--input and --output-prefix are required')
+
+    f = open (options.input)
+    service = Service (json.load (f))
+    f.close ()
+
+    basename = os.path.basename (options.output_prefix)
+    guard = '_LIBQMI_GLIB_%s_H_' % underscore (basename).upper ()
+
+    f = open (options.output_prefix + '.h', 'w')
+    f.write (HEADER.format (input = os.path.basename (options.input)))
+    f.write ('/* NOTE: this is a private non-installable header */\n\n'
+             '#ifndef %s\n'
+             '#define %s\n'
+             '\n'
+             '#include <glib.h>\n'
+             '\n'
+             '#include "qmi-%s.h"\n'
+             '\n'
+             'G_BEGIN_DECLS\n'
+             '\n' % (guard, guard, service.underscore))
+    for message in service.messages:
+        message.emit_header (f)
+    f.write ('G_END_DECLS\n'
+             '\n'
+             '#endif /* %s */\n' % guard)
+    f.close ()
+
+    f = open (options.output_prefix + '.c', 'w')
+    f.write (HEADER.format (input = os.path.basename (options.input)))
+    f.write ('#include <string.h>\n'
+             '\n'
+             '#include "qmi-message-%s.h"\n'
+             '#include "qmi-enums.h"\n'
+             '#include "qmi-error-types.h"\n'
+             '#include "%s.h"\n'
+             '\n' % (service.underscore, basename))
+    f.write (COMMON_SOURCE)
+    for message in service.messages:
+        message.emit_source (f)
+    f.close ()
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit (main ())
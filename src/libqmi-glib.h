@@ -28,6 +28,7 @@
 #include "qmi-enum-types.h"
 
 #include "qmi-device.h"
+#include "qmi-device-manager.h"
 #include "qmi-client.h"
 #include "qmi-client-dms.h"
 #include "qmi-client-wds.h"
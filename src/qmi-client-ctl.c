@@ -27,6 +27,7 @@
 #include "qmi-device.h"
 #include "qmi-client-ctl.h"
 #include "qmi-message-ctl.h"
+#include "qmi-utils.h"
 
 G_DEFINE_TYPE (QmiClientCtl, qmi_client_ctl, QMI_TYPE_CLIENT)
 
@@ -86,6 +87,41 @@ version_info_ready (QmiDevice *device,
     qmi_message_unref (reply);
 }
 
+/**
+ * qmi_client_ctl_get_version_info_ms:
+ * @self: a #QmiClientCtl.
+ * @timeout_ms: maximum time to wait to get the operation completed, in milliseconds.
+ * @cancellable: optional #GCancellable object, #NULL to ignore.
+ * @callback: a #GAsyncReadyCallback to call when the operation is finished.
+ * @user_data: the data to pass to callback function.
+ *
+ * Like qmi_client_ctl_get_version_info(), but with the timeout given in milliseconds.
+ */
+void
+qmi_client_ctl_get_version_info_ms (QmiClientCtl *self,
+                                    guint timeout_ms,
+                                    GCancellable *cancellable,
+                                    GAsyncReadyCallback callback,
+                                    gpointer user_data)
+{
+    GSimpleAsyncResult *result;
+    QmiMessage *request;
+
+    result = g_simple_async_result_new (G_OBJECT (self),
+                                        callback,
+                                        user_data,
+                                        qmi_client_ctl_get_version_info);
+
+    request = qmi_message_ctl_version_info_new (qmi_client_get_next_transaction_id (QMI_CLIENT (self)));
+    qmi_device_command_ms (QMI_DEVICE (qmi_client_peek_device (QMI_CLIENT (self))),
+                           request,
+                           timeout_ms,
+                           cancellable,
+                           (GAsyncReadyCallback)version_info_ready,
+                           result);
+    qmi_message_unref (request);
+}
+
 /**
  * qmi_client_ctl_get_version_info:
  * @self: a #QmiClientCtl.
@@ -105,22 +141,11 @@ qmi_client_ctl_get_version_info (QmiClientCtl *self,
                                  GAsyncReadyCallback callback,
                                  gpointer user_data)
 {
-    GSimpleAsyncResult *result;
-    QmiMessage *request;
-
-    result = g_simple_async_result_new (G_OBJECT (self),
+    qmi_client_ctl_get_version_info_ms (self,
+                                        qmi_utils_timeout_to_ms (timeout),
+                                        cancellable,
                                         callback,
-                                        user_data,
-                                        qmi_client_ctl_get_version_info);
-
-    request = qmi_message_ctl_version_info_new (qmi_client_get_next_transaction_id (QMI_CLIENT (self)));
-    qmi_device_command (QMI_DEVICE (qmi_client_peek_device (QMI_CLIENT (self))),
-                        request,
-                        timeout,
-                        cancellable,
-                        (GAsyncReadyCallback)version_info_ready,
-                        result);
-    qmi_message_unref (request);
+                                        user_data);
 }
 
 /*****************************************************************************/
@@ -217,25 +242,23 @@ allocate_cid_ready (QmiDevice *device,
 }
 
 /**
- * qmi_client_ctl_allocate_cid:
+ * qmi_client_ctl_allocate_cid_ms:
  * @self: a #QmiClientCtl.
  * @service: a #QmiService.
- * @timeout: maximum time to wait to get the operation completed.
+ * @timeout_ms: maximum time to wait to get the operation completed, in milliseconds.
  * @cancellable: optional #GCancellable object, #NULL to ignore.
  * @callback: a #GAsyncReadyCallback to call when the operation is finished.
  * @user_data: the data to pass to callback function.
  *
- * Allocate a new client ID for the given @service..
- * When the query is finished, @callback will be called. You can then call
- * qmi_client_ctl_allocate_cid_finish() to get the the result of the operation.
+ * Like qmi_client_ctl_allocate_cid(), but with the timeout given in milliseconds.
  */
 void
-qmi_client_ctl_allocate_cid (QmiClientCtl *self,
-                             QmiService service,
-                             guint timeout,
-                             GCancellable *cancellable,
-                             GAsyncReadyCallback callback,
-                             gpointer user_data)
+qmi_client_ctl_allocate_cid_ms (QmiClientCtl *self,
+                                QmiService service,
+                                guint timeout_ms,
+                                GCancellable *cancellable,
+                                GAsyncReadyCallback callback,
+                                gpointer user_data)
 {
     AllocateCidContext *ctx;
     QmiMessage *request;
@@ -250,15 +273,44 @@ qmi_client_ctl_allocate_cid (QmiClientCtl *self,
 
     request = qmi_message_ctl_allocate_cid_new (qmi_client_get_next_transaction_id (QMI_CLIENT (self)),
                                                 service);
-    qmi_device_command (QMI_DEVICE (qmi_client_peek_device (QMI_CLIENT (self))),
-                        request,
-                        timeout,
-                        cancellable,
-                        (GAsyncReadyCallback)allocate_cid_ready,
-                        ctx);
+    qmi_device_command_ms (QMI_DEVICE (qmi_client_peek_device (QMI_CLIENT (self))),
+                           request,
+                           timeout_ms,
+                           cancellable,
+                           (GAsyncReadyCallback)allocate_cid_ready,
+                           ctx);
     qmi_message_unref (request);
 }
 
+/**
+ * qmi_client_ctl_allocate_cid:
+ * @self: a #QmiClientCtl.
+ * @service: a #QmiService.
+ * @timeout: maximum time to wait to get the operation completed.
+ * @cancellable: optional #GCancellable object, #NULL to ignore.
+ * @callback: a #GAsyncReadyCallback to call when the operation is finished.
+ * @user_data: the data to pass to callback function.
+ *
+ * Allocate a new client ID for the given @service..
+ * When the query is finished, @callback will be called. You can then call
+ * qmi_client_ctl_allocate_cid_finish() to get the the result of the operation.
+ */
+void
+qmi_client_ctl_allocate_cid (QmiClientCtl *self,
+                             QmiService service,
+                             guint timeout,
+                             GCancellable *cancellable,
+                             GAsyncReadyCallback callback,
+                             gpointer user_data)
+{
+    qmi_client_ctl_allocate_cid_ms (self,
+                                    service,
+                                    qmi_utils_timeout_to_ms (timeout),
+                                    cancellable,
+                                    callback,
+                                    user_data);
+}
+
 /*****************************************************************************/
 /* Release CID */
 
@@ -362,27 +414,25 @@ release_cid_ready (QmiDevice *device,
 }
 
 /**
- * qmi_client_ctl_release_cid:
+ * qmi_client_ctl_release_cid_ms:
  * @self: a #QmiClientCtl.
  * @service: a #QmiService.
  * @cid: the client ID to release.
- * @timeout: maximum time to wait to get the operation completed.
+ * @timeout_ms: maximum time to wait to get the operation completed, in milliseconds.
  * @cancellable: optional #GCancellable object, #NULL to ignore.
  * @callback: a #GAsyncReadyCallback to call when the operation is finished.
  * @user_data: the data to pass to callback function.
  *
- * Release a previously allocated client ID for the given @service.
- * When the query is finished, @callback will be called. You can then call
- * qmi_client_ctl_release_cid_finish() to get the the result of the operation.
+ * Like qmi_client_ctl_release_cid(), but with the timeout given in milliseconds.
  */
 void
-qmi_client_ctl_release_cid (QmiClientCtl *self,
-                            QmiService service,
-                            guint8 cid,
-                            guint timeout,
-                            GCancellable *cancellable,
-                            GAsyncReadyCallback callback,
-                            gpointer user_data)
+qmi_client_ctl_release_cid_ms (QmiClientCtl *self,
+                               QmiService service,
+                               guint8 cid,
+                               guint timeout_ms,
+                               GCancellable *cancellable,
+                               GAsyncReadyCallback callback,
+                               gpointer user_data)
 {
     ReleaseCidContext *ctx;
     QmiMessage *request;
@@ -399,15 +449,47 @@ qmi_client_ctl_release_cid (QmiClientCtl *self,
     request = qmi_message_ctl_release_cid_new (qmi_client_get_next_transaction_id (QMI_CLIENT (self)),
                                                service,
                                                cid);
-    qmi_device_command (QMI_DEVICE (qmi_client_peek_device (QMI_CLIENT (self))),
-                        request,
-                        timeout,
-                        cancellable,
-                        (GAsyncReadyCallback)release_cid_ready,
-                        ctx);
+    qmi_device_command_ms (QMI_DEVICE (qmi_client_peek_device (QMI_CLIENT (self))),
+                           request,
+                           timeout_ms,
+                           cancellable,
+                           (GAsyncReadyCallback)release_cid_ready,
+                           ctx);
     qmi_message_unref (request);
 }
 
+/**
+ * qmi_client_ctl_release_cid:
+ * @self: a #QmiClientCtl.
+ * @service: a #QmiService.
+ * @cid: the client ID to release.
+ * @timeout: maximum time to wait to get the operation completed.
+ * @cancellable: optional #GCancellable object, #NULL to ignore.
+ * @callback: a #GAsyncReadyCallback to call when the operation is finished.
+ * @user_data: the data to pass to callback function.
+ *
+ * Release a previously allocated client ID for the given @service.
+ * When the query is finished, @callback will be called. You can then call
+ * qmi_client_ctl_release_cid_finish() to get the the result of the operation.
+ */
+void
+qmi_client_ctl_release_cid (QmiClientCtl *self,
+                            QmiService service,
+                            guint8 cid,
+                            guint timeout,
+                            GCancellable *cancellable,
+                            GAsyncReadyCallback callback,
+                            gpointer user_data)
+{
+    qmi_client_ctl_release_cid_ms (self,
+                                   service,
+                                   cid,
+                                   qmi_utils_timeout_to_ms (timeout),
+                                   cancellable,
+                                   callback,
+                                   user_data);
+}
+
 /*****************************************************************************/
 /* Sync */
 
@@ -450,23 +532,21 @@ sync_command_ready (QmiDevice *device,
 }
 
 /**
- * qmi_client_ctl_sync:
+ * qmi_client_ctl_sync_ms:
  * @self: a #QmiClientCtl.
- * @timeout: maximum time to wait to get the operation completed.
+ * @timeout_ms: maximum time to wait to get the operation completed, in milliseconds.
  * @cancellable: optional #GCancellable object, #NULL to ignore.
  * @callback: a #GAsyncReadyCallback to call when the operation is finished.
  * @user_data: the data to pass to callback function.
  *
- * Request to sync with the device.
- * When the operation is finished, @callback will be called. You can then call
- * qmi_client_ctl_sync_finish() to get the the result of the operation.
+ * Like qmi_client_ctl_sync(), but with the timeout given in milliseconds.
  */
 void
-qmi_client_ctl_sync (QmiClientCtl *self,
-                     guint timeout,
-                     GCancellable *cancellable,
-                     GAsyncReadyCallback callback,
-                     gpointer user_data)
+qmi_client_ctl_sync_ms (QmiClientCtl *self,
+                        guint timeout_ms,
+                        GCancellable *cancellable,
+                        GAsyncReadyCallback callback,
+                        gpointer user_data)
 {
     GSimpleAsyncResult *result;
     QmiMessage *request;
@@ -477,15 +557,41 @@ qmi_client_ctl_sync (QmiClientCtl *self,
                                         qmi_client_ctl_sync);
 
     request = qmi_message_ctl_sync_new (qmi_client_get_next_transaction_id (QMI_CLIENT (self)));
-    qmi_device_command (QMI_DEVICE (qmi_client_peek_device (QMI_CLIENT (self))),
-                        request,
-                        timeout,
-                        cancellable,
-                        (GAsyncReadyCallback)sync_command_ready,
-                        result);
+    qmi_device_command_ms (QMI_DEVICE (qmi_client_peek_device (QMI_CLIENT (self))),
+                           request,
+                           timeout_ms,
+                           cancellable,
+                           (GAsyncReadyCallback)sync_command_ready,
+                           result);
     qmi_message_unref (request);
 }
 
+/**
+ * qmi_client_ctl_sync:
+ * @self: a #QmiClientCtl.
+ * @timeout: maximum time to wait to get the operation completed.
+ * @cancellable: optional #GCancellable object, #NULL to ignore.
+ * @callback: a #GAsyncReadyCallback to call when the operation is finished.
+ * @user_data: the data to pass to callback function.
+ *
+ * Request to sync with the device.
+ * When the operation is finished, @callback will be called. You can then call
+ * qmi_client_ctl_sync_finish() to get the the result of the operation.
+ */
+void
+qmi_client_ctl_sync (QmiClientCtl *self,
+                     guint timeout,
+                     GCancellable *cancellable,
+                     GAsyncReadyCallback callback,
+                     gpointer user_data)
+{
+    qmi_client_ctl_sync_ms (self,
+                            qmi_utils_timeout_to_ms (timeout),
+                            cancellable,
+                            callback,
+                            user_data);
+}
+
 static void
 qmi_client_ctl_init (QmiClientCtl *self)
 {
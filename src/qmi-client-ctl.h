@@ -57,6 +57,11 @@ void    qmi_client_ctl_get_version_info           (QmiClientCtl *self,
                                                    GCancellable *cancellable,
                                                    GAsyncReadyCallback callback,
                                                    gpointer user_data);
+void    qmi_client_ctl_get_version_info_ms        (QmiClientCtl *self,
+                                                   guint timeout_ms,
+                                                   GCancellable *cancellable,
+                                                   GAsyncReadyCallback callback,
+                                                   gpointer user_data);
 GPtrArray *qmi_client_ctl_get_version_info_finish (QmiClientCtl *self,
                                                    GAsyncResult *res,
                                                    GError **error);
@@ -68,6 +73,12 @@ void   qmi_client_ctl_allocate_cid        (QmiClientCtl *self,
                                            GCancellable *cancellable,
                                            GAsyncReadyCallback callback,
                                            gpointer user_data);
+void   qmi_client_ctl_allocate_cid_ms     (QmiClientCtl *self,
+                                           QmiService service,
+                                           guint timeout_ms,
+                                           GCancellable *cancellable,
+                                           GAsyncReadyCallback callback,
+                                           gpointer user_data);
 guint8 qmi_client_ctl_allocate_cid_finish (QmiClientCtl *self,
                                            GAsyncResult *res,
                                            GError **error);
@@ -80,6 +91,13 @@ void   qmi_client_ctl_release_cid          (QmiClientCtl *self,
                                             GCancellable *cancellable,
                                             GAsyncReadyCallback callback,
                                             gpointer user_data);
+void   qmi_client_ctl_release_cid_ms       (QmiClientCtl *self,
+                                            QmiService service,
+                                            guint8 cid,
+                                            guint timeout_ms,
+                                            GCancellable *cancellable,
+                                            GAsyncReadyCallback callback,
+                                            gpointer user_data);
 gboolean qmi_client_ctl_release_cid_finish (QmiClientCtl *self,
                                             GAsyncResult *res,
                                             GError **error);
@@ -90,6 +108,11 @@ void     qmi_client_ctl_sync        (QmiClientCtl *self,
                                      GCancellable *cancellable,
                                      GAsyncReadyCallback callback,
                                      gpointer user_data);
+void     qmi_client_ctl_sync_ms     (QmiClientCtl *self,
+                                     guint timeout_ms,
+                                     GCancellable *cancellable,
+                                     GAsyncReadyCallback callback,
+                                     gpointer user_data);
 gboolean qmi_client_ctl_sync_finish (QmiClientCtl *self,
                                      GAsyncResult *res,
                                      GError **error);
@@ -26,6 +26,7 @@
 #include "qmi-device.h"
 #include "qmi-client-dms.h"
 #include "qmi-message-dms.h"
+#include "qmi-utils.h"
 
 G_DEFINE_TYPE (QmiClientDms, qmi_client_dms, QMI_TYPE_CLIENT)
 
@@ -76,11 +77,11 @@ get_ids_ready (QmiDevice *device,
 }
 
 void
-qmi_client_dms_get_ids (QmiClientDms *self,
-                        guint timeout,
-                        GCancellable *cancellable,
-                        GAsyncReadyCallback callback,
-                        gpointer user_data)
+qmi_client_dms_get_ids_ms (QmiClientDms *self,
+                           guint timeout_ms,
+                           GCancellable *cancellable,
+                           GAsyncReadyCallback callback,
+                           gpointer user_data)
 {
     GSimpleAsyncResult *result;
     QmiMessage *request;
@@ -92,15 +93,29 @@ qmi_client_dms_get_ids (QmiClientDms *self,
 
     request = qmi_message_dms_get_ids_new (qmi_client_get_next_transaction_id (QMI_CLIENT (self)),
                                            qmi_client_get_cid (QMI_CLIENT (self)));
-    qmi_device_command (QMI_DEVICE (qmi_client_peek_device (QMI_CLIENT (self))),
-                        request,
-                        timeout,
-                        cancellable,
-                        (GAsyncReadyCallback)get_ids_ready,
-                        result);
+    qmi_device_command_ms (QMI_DEVICE (qmi_client_peek_device (QMI_CLIENT (self))),
+                           request,
+                           timeout_ms,
+                           cancellable,
+                           (GAsyncReadyCallback)get_ids_ready,
+                           result);
     qmi_message_unref (request);
 }
 
+void
+qmi_client_dms_get_ids (QmiClientDms *self,
+                        guint timeout,
+                        GCancellable *cancellable,
+                        GAsyncReadyCallback callback,
+                        gpointer user_data)
+{
+    qmi_client_dms_get_ids_ms (self,
+                               qmi_utils_timeout_to_ms (timeout),
+                               cancellable,
+                               callback,
+                               user_data);
+}
+
 /*****************************************************************************/
 
 static void
@@ -57,6 +57,11 @@ void                qmi_client_dms_get_ids        (QmiClientDms *self,
                                                    GCancellable *cancellable,
                                                    GAsyncReadyCallback callback,
                                                    gpointer user_data);
+void                qmi_client_dms_get_ids_ms     (QmiClientDms *self,
+                                                   guint timeout_ms,
+                                                   GCancellable *cancellable,
+                                                   GAsyncReadyCallback callback,
+                                                   gpointer user_data);
 QmiDmsGetIdsOutput *qmi_client_dms_get_ids_finish (QmiClientDms *self,
                                                    GAsyncResult *res,
                                                    GError **error);
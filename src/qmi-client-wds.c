@@ -25,6 +25,7 @@
 #include "qmi-device.h"
 #include "qmi-client-wds.h"
 #include "qmi-message-wds.h"
+#include "qmi-utils.h"
 
 G_DEFINE_TYPE (QmiClientWds, qmi_client_wds, QMI_TYPE_CLIENT)
 
@@ -73,12 +74,12 @@ start_network_ready (QmiDevice *device,
 }
 
 void
-qmi_client_wds_start_network (QmiClientWds *self,
-                              QmiWdsStartNetworkInput *input,
-                              guint timeout,
-                              GCancellable *cancellable,
-                              GAsyncReadyCallback callback,
-                              gpointer user_data)
+qmi_client_wds_start_network_ms (QmiClientWds *self,
+                                 QmiWdsStartNetworkInput *input,
+                                 guint timeout_ms,
+                                 GCancellable *cancellable,
+                                 GAsyncReadyCallback callback,
+                                 gpointer user_data)
 {
     GSimpleAsyncResult *result;
     QmiMessage *request;
@@ -101,15 +102,31 @@ qmi_client_wds_start_network (QmiClientWds *self,
         return;
     }
 
-    qmi_device_command (QMI_DEVICE (qmi_client_peek_device (QMI_CLIENT (self))),
-                        request,
-                        timeout,
-                        cancellable,
-                        (GAsyncReadyCallback)start_network_ready,
-                        result);
+    qmi_device_command_ms (QMI_DEVICE (qmi_client_peek_device (QMI_CLIENT (self))),
+                           request,
+                           timeout_ms,
+                           cancellable,
+                           (GAsyncReadyCallback)start_network_ready,
+                           result);
     qmi_message_unref (request);
 }
 
+void
+qmi_client_wds_start_network (QmiClientWds *self,
+                              QmiWdsStartNetworkInput *input,
+                              guint timeout,
+                              GCancellable *cancellable,
+                              GAsyncReadyCallback callback,
+                              gpointer user_data)
+{
+    qmi_client_wds_start_network_ms (self,
+                                     input,
+                                     qmi_utils_timeout_to_ms (timeout),
+                                     cancellable,
+                                     callback,
+                                     user_data);
+}
+
 /*****************************************************************************/
 /* Stop network */
 
@@ -155,12 +172,12 @@ stop_network_ready (QmiDevice *device,
 }
 
 void
-qmi_client_wds_stop_network (QmiClientWds *self,
-                             QmiWdsStopNetworkInput *input,
-                             guint timeout,
-                             GCancellable *cancellable,
-                             GAsyncReadyCallback callback,
-                             gpointer user_data)
+qmi_client_wds_stop_network_ms (QmiClientWds *self,
+                                QmiWdsStopNetworkInput *input,
+                                guint timeout_ms,
+                                GCancellable *cancellable,
+                                GAsyncReadyCallback callback,
+                                gpointer user_data)
 {
     GSimpleAsyncResult *result;
     QmiMessage *request;
@@ -183,15 +200,31 @@ qmi_client_wds_stop_network (QmiClientWds *self,
         return;
     }
 
-    qmi_device_command (QMI_DEVICE (qmi_client_peek_device (QMI_CLIENT (self))),
-                        request,
-                        timeout,
-                        cancellable,
-                        (GAsyncReadyCallback)stop_network_ready,
-                        result);
+    qmi_device_command_ms (QMI_DEVICE (qmi_client_peek_device (QMI_CLIENT (self))),
+                           request,
+                           timeout_ms,
+                           cancellable,
+                           (GAsyncReadyCallback)stop_network_ready,
+                           result);
     qmi_message_unref (request);
 }
 
+void
+qmi_client_wds_stop_network (QmiClientWds *self,
+                             QmiWdsStopNetworkInput *input,
+                             guint timeout,
+                             GCancellable *cancellable,
+                             GAsyncReadyCallback callback,
+                             gpointer user_data)
+{
+    qmi_client_wds_stop_network_ms (self,
+                                    input,
+                                    qmi_utils_timeout_to_ms (timeout),
+                                    cancellable,
+                                    callback,
+                                    user_data);
+}
+
 /*****************************************************************************/
 /* Get packet service status */
 
@@ -237,12 +270,12 @@ get_packet_service_status_ready (QmiDevice *device,
 }
 
 void
-qmi_client_wds_get_packet_service_status (QmiClientWds *self,
-                                          gpointer input_unused,
-                                          guint timeout,
-                                          GCancellable *cancellable,
-                                          GAsyncReadyCallback callback,
-                                          gpointer user_data)
+qmi_client_wds_get_packet_service_status_ms (QmiClientWds *self,
+                                             gpointer input_unused,
+                                             guint timeout_ms,
+                                             GCancellable *cancellable,
+                                             GAsyncReadyCallback callback,
+                                             gpointer user_data)
 {
     GSimpleAsyncResult *result;
     QmiMessage *request;
@@ -254,15 +287,31 @@ qmi_client_wds_get_packet_service_status (QmiClientWds *self,
 
     request = qmi_message_wds_get_packet_service_status_new (qmi_client_get_next_transaction_id (QMI_CLIENT (self)),
                                                              qmi_client_get_cid (QMI_CLIENT (self)));
-    qmi_device_command (QMI_DEVICE (qmi_client_peek_device (QMI_CLIENT (self))),
-                        request,
-                        timeout,
-                        cancellable,
-                        (GAsyncReadyCallback)get_packet_service_status_ready,
-                        result);
+    qmi_device_command_ms (QMI_DEVICE (qmi_client_peek_device (QMI_CLIENT (self))),
+                           request,
+                           timeout_ms,
+                           cancellable,
+                           (GAsyncReadyCallback)get_packet_service_status_ready,
+                           result);
     qmi_message_unref (request);
 }
 
+void
+qmi_client_wds_get_packet_service_status (QmiClientWds *self,
+                                          gpointer input_unused,
+                                          guint timeout,
+                                          GCancellable *cancellable,
+                                          GAsyncReadyCallback callback,
+                                          gpointer user_data)
+{
+    qmi_client_wds_get_packet_service_status_ms (self,
+                                                 input_unused,
+                                                 qmi_utils_timeout_to_ms (timeout),
+                                                 cancellable,
+                                                 callback,
+                                                 user_data);
+}
+
 /*****************************************************************************/
 /* Get data bearer technology */
 
@@ -308,12 +357,12 @@ get_data_bearer_technology_ready (QmiDevice *device,
 }
 
 void
-qmi_client_wds_get_data_bearer_technology (QmiClientWds *self,
-                                           gpointer input_unused,
-                                           guint timeout,
-                                           GCancellable *cancellable,
-                                           GAsyncReadyCallback callback,
-                                           gpointer user_data)
+qmi_client_wds_get_data_bearer_technology_ms (QmiClientWds *self,
+                                              gpointer input_unused,
+                                              guint timeout_ms,
+                                              GCancellable *cancellable,
+                                              GAsyncReadyCallback callback,
+                                              gpointer user_data)
 {
     GSimpleAsyncResult *result;
     QmiMessage *request;
@@ -325,15 +374,31 @@ qmi_client_wds_get_data_bearer_technology (QmiClientWds *self,
 
     request = qmi_message_wds_get_data_bearer_technology_new (qmi_client_get_next_transaction_id (QMI_CLIENT (self)),
                                                               qmi_client_get_cid (QMI_CLIENT (self)));
-    qmi_device_command (QMI_DEVICE (qmi_client_peek_device (QMI_CLIENT (self))),
-                        request,
-                        timeout,
-                        cancellable,
-                        (GAsyncReadyCallback)get_data_bearer_technology_ready,
-                        result);
+    qmi_device_command_ms (QMI_DEVICE (qmi_client_peek_device (QMI_CLIENT (self))),
+                           request,
+                           timeout_ms,
+                           cancellable,
+                           (GAsyncReadyCallback)get_data_bearer_technology_ready,
+                           result);
     qmi_message_unref (request);
 }
 
+void
+qmi_client_wds_get_data_bearer_technology (QmiClientWds *self,
+                                           gpointer input_unused,
+                                           guint timeout,
+                                           GCancellable *cancellable,
+                                           GAsyncReadyCallback callback,
+                                           gpointer user_data)
+{
+    qmi_client_wds_get_data_bearer_technology_ms (self,
+                                                  input_unused,
+                                                  qmi_utils_timeout_to_ms (timeout),
+                                                  cancellable,
+                                                  callback,
+                                                  user_data);
+}
+
 /*****************************************************************************/
 /* Get current data bearer technology */
 
@@ -379,12 +444,12 @@ get_current_data_bearer_technology_ready (QmiDevice *device,
 }
 
 void
-qmi_client_wds_get_current_data_bearer_technology (QmiClientWds *self,
-                                                   gpointer input_unused,
-                                                   guint timeout,
-                                                   GCancellable *cancellable,
-                                                   GAsyncReadyCallback callback,
-                                                   gpointer user_data)
+qmi_client_wds_get_current_data_bearer_technology_ms (QmiClientWds *self,
+                                                      gpointer input_unused,
+                                                      guint timeout_ms,
+                                                      GCancellable *cancellable,
+                                                      GAsyncReadyCallback callback,
+                                                      gpointer user_data)
 {
     GSimpleAsyncResult *result;
     QmiMessage *request;
@@ -396,15 +461,31 @@ qmi_client_wds_get_current_data_bearer_technology (QmiClientWds *self,
 
     request = qmi_message_wds_get_current_data_bearer_technology_new (qmi_client_get_next_transaction_id (QMI_CLIENT (self)),
                                                                       qmi_client_get_cid (QMI_CLIENT (self)));
-    qmi_device_command (QMI_DEVICE (qmi_client_peek_device (QMI_CLIENT (self))),
-                        request,
-                        timeout,
-                        cancellable,
-                        (GAsyncReadyCallback)get_current_data_bearer_technology_ready,
-                        result);
+    qmi_device_command_ms (QMI_DEVICE (qmi_client_peek_device (QMI_CLIENT (self))),
+                           request,
+                           timeout_ms,
+                           cancellable,
+                           (GAsyncReadyCallback)get_current_data_bearer_technology_ready,
+                           result);
     qmi_message_unref (request);
 }
 
+void
+qmi_client_wds_get_current_data_bearer_technology (QmiClientWds *self,
+                                                   gpointer input_unused,
+                                                   guint timeout,
+                                                   GCancellable *cancellable,
+                                                   GAsyncReadyCallback callback,
+                                                   gpointer user_data)
+{
+    qmi_client_wds_get_current_data_bearer_technology_ms (self,
+                                                          input_unused,
+                                                          qmi_utils_timeout_to_ms (timeout),
+                                                          cancellable,
+                                                          callback,
+                                                          user_data);
+}
+
 /*****************************************************************************/
 
 static void
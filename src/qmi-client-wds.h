@@ -59,6 +59,12 @@ void                      qmi_client_wds_start_network        (QmiClientWds *sel
                                                                GCancellable *cancellable,
                                                                GAsyncReadyCallback callback,
                                                                gpointer user_data);
+void                      qmi_client_wds_start_network_ms     (QmiClientWds *self,
+                                                               QmiWdsStartNetworkInput *input,
+                                                               guint timeout_ms,
+                                                               GCancellable *cancellable,
+                                                               GAsyncReadyCallback callback,
+                                                               gpointer user_data);
 QmiWdsStartNetworkOutput *qmi_client_wds_start_network_finish (QmiClientWds *self,
                                                                GAsyncResult *res,
                                                                GError **error);
@@ -71,6 +77,12 @@ void                      qmi_client_wds_stop_network        (QmiClientWds *self
                                                               GCancellable *cancellable,
                                                               GAsyncReadyCallback callback,
                                                               gpointer user_data);
+void                      qmi_client_wds_stop_network_ms     (QmiClientWds *self,
+                                                              QmiWdsStopNetworkInput *input,
+                                                              guint timeout_ms,
+                                                              GCancellable *cancellable,
+                                                              GAsyncReadyCallback callback,
+                                                              gpointer user_data);
 QmiWdsStopNetworkOutput *qmi_client_wds_stop_network_finish (QmiClientWds *self,
                                                              GAsyncResult *res,
                                                              GError **error);
@@ -83,6 +95,12 @@ void                                qmi_client_wds_get_packet_service_status
                                                                                      GCancellable *cancellable,
                                                                                      GAsyncReadyCallback callback,
                                                                                      gpointer user_data);
+void                                qmi_client_wds_get_packet_service_status_ms     (QmiClientWds *self,
+                                                                                     gpointer input_unused,
+                                                                                     guint timeout_ms,
+                                                                                     GCancellable *cancellable,
+                                                                                     GAsyncReadyCallback callback,
+                                                                                     gpointer user_data);
 QmiWdsGetPacketServiceStatusOutput *qmi_client_wds_get_packet_service_status_finish (QmiClientWds *self,
                                                                                      GAsyncResult *res,
                                                                                      GError **error);
@@ -95,6 +113,12 @@ void                                qmi_client_wds_get_data_bearer_technology
                                                                                       GCancellable *cancellable,
                                                                                       GAsyncReadyCallback callback,
                                                                                       gpointer user_data);
+void                                qmi_client_wds_get_data_bearer_technology_ms     (QmiClientWds *self,
+                                                                                      gpointer input_unused,
+                                                                                      guint timeout_ms,
+                                                                                      GCancellable *cancellable,
+                                                                                      GAsyncReadyCallback callback,
+                                                                                      gpointer user_data);
 QmiWdsGetDataBearerTechnologyOutput *qmi_client_wds_get_data_bearer_technology_finish (QmiClientWds *self,
                                                                                        GAsyncResult *res,
                                                                                        GError **error);
@@ -107,6 +131,12 @@ void                                        qmi_client_wds_get_current_data_bear
                                                                                                       GCancellable *cancellable,
                                                                                                       GAsyncReadyCallback callback,
                                                                                                       gpointer user_data);
+void                                        qmi_client_wds_get_current_data_bearer_technology_ms     (QmiClientWds *self,
+                                                                                                      gpointer input_unused,
+                                                                                                      guint timeout_ms,
+                                                                                                      GCancellable *cancellable,
+                                                                                                      GAsyncReadyCallback callback,
+                                                                                                      gpointer user_data);
 QmiWdsGetCurrentDataBearerTechnologyOutput *qmi_client_wds_get_current_data_bearer_technology_finish (QmiClientWds *self,
                                                                                                       GAsyncResult *res,
                                                                                                       GError **error);
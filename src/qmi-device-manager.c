@@ -0,0 +1,591 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+#include <gio/gio.h>
+
+#include "qmi-device-manager.h"
+
+G_DEFINE_TYPE (QmiDeviceManager, qmi_device_manager, G_TYPE_OBJECT)
+
+struct _QmiDeviceManagerPrivate {
+    /* Devices in the order their paths were given, all of them driven from
+     * the main context the manager was opened from; NULL for the paths which
+     * couldn't be open */
+    GPtrArray *devices;
+};
+
+static void
+device_unref (QmiDevice *device)
+{
+    if (device)
+        g_object_unref (device);
+}
+
+/*****************************************************************************/
+
+/**
+ * qmi_device_manager_get_n_devices:
+ * @self: a #QmiDeviceManager.
+ *
+ * Gets the number of devices currently managed, one per path given to
+ * qmi_device_manager_open(), including those which couldn't be open.
+ *
+ * Returns: the number of managed devices.
+ */
+guint
+qmi_device_manager_get_n_devices (QmiDeviceManager *self)
+{
+    g_return_val_if_fail (QMI_IS_DEVICE_MANAGER (self), 0);
+
+    return self->priv->devices->len;
+}
+
+/**
+ * qmi_device_manager_peek_device:
+ * @self: a #QmiDeviceManager.
+ * @i: index of the device, lower than qmi_device_manager_get_n_devices().
+ *
+ * Gets one of the managed devices, without increasing its reference count.
+ * Devices keep the order of the paths given to qmi_device_manager_open().
+ *
+ * Returns: a #QmiDevice, or #NULL if the device at @i couldn't be open. Do not
+ * free the returned object, it is owned by @self.
+ */
+QmiDevice *
+qmi_device_manager_peek_device (QmiDeviceManager *self,
+                                guint i)
+{
+    g_return_val_if_fail (QMI_IS_DEVICE_MANAGER (self), NULL);
+    g_return_val_if_fail (i < self->priv->devices->len, NULL);
+
+    return g_ptr_array_index (self->priv->devices, i);
+}
+
+/*****************************************************************************/
+
+/**
+ * qmi_device_manager_get_stats:
+ * @self: a #QmiDeviceManager.
+ * @stats: a #QmiDeviceStats to fill in.
+ *
+ * Gets the I/O statistics of all the managed devices added together. The
+ * statistics of each device can be queried with qmi_device_get_stats(); the
+ * reported reconnection time is the longest one among them.
+ */
+void
+qmi_device_manager_get_stats (QmiDeviceManager *self,
+                              QmiDeviceStats *stats)
+{
+    guint i;
+
+    g_return_if_fail (QMI_IS_DEVICE_MANAGER (self));
+    g_return_if_fail (stats != NULL);
+
+    memset (stats, 0, sizeof (QmiDeviceStats));
+
+    for (i = 0; i < self->priv->devices->len; i++) {
+        QmiDevice *device;
+        QmiDeviceStats device_stats;
+
+        device = g_ptr_array_index (self->priv->devices, i);
+        if (!device)
+            continue;
+
+        qmi_device_get_stats (device, &device_stats);
+        stats->message_pool_hits += device_stats.message_pool_hits;
+        stats->message_pool_misses += device_stats.message_pool_misses;
+        stats->write_queue_depth += device_stats.write_queue_depth;
+        stats->write_bytes_pending += device_stats.write_bytes_pending;
+        stats->rx_bytes_dropped += device_stats.rx_bytes_dropped;
+        stats->rx_frames_dropped += device_stats.rx_frames_dropped;
+        stats->in_flight += device_stats.in_flight;
+        stats->pending_queue_depth += device_stats.pending_queue_depth;
+        stats->read_syscalls += device_stats.read_syscalls;
+        stats->write_syscalls += device_stats.write_syscalls;
+        stats->frames_received += device_stats.frames_received;
+        stats->reconnects += device_stats.reconnects;
+        stats->last_reconnect_time = MAX (stats->last_reconnect_time,
+                                          device_stats.last_reconnect_time);
+    }
+}
+
+/*****************************************************************************/
+/* Open devices */
+
+typedef struct {
+    QmiDeviceManager *self;
+    GSimpleAsyncResult *result;
+    GCancellable *cancellable;
+    QmiDeviceOpenFlags flags;
+    guint timeout;
+    guint n_pending;
+    guint n_failed;
+    guint n_total;
+    GError *error; /* first one found */
+} OpenContext;
+
+typedef struct {
+    OpenContext *ctx;
+    guint i; /* slot of the device in the managed devices */
+} OpenDeviceContext;
+
+static void
+open_context_device_done (OpenContext *ctx,
+                          guint i,
+                          QmiDevice *device,
+                          GError *error)
+{
+    if (device) {
+        /* Unless the manager was closed meanwhile */
+        if (i < ctx->self->priv->devices->len &&
+            !g_ptr_array_index (ctx->self->priv->devices, i))
+            g_ptr_array_index (ctx->self->priv->devices, i) = device;
+        else
+            g_object_unref (device);
+    } else if (error) {
+        ctx->n_failed++;
+        if (!ctx->error)
+            ctx->error = error;
+        else
+            g_error_free (error);
+    }
+
+    if (--ctx->n_pending > 0)
+        return;
+
+    if (ctx->n_failed > 0) {
+        g_prefix_error (&ctx->error,
+                        "%u of %u devices couldn't be open: ",
+                        ctx->n_failed, ctx->n_total);
+        g_simple_async_result_take_error (ctx->result, ctx->error);
+    } else
+        g_simple_async_result_set_op_res_gboolean (ctx->result, TRUE);
+
+    g_simple_async_result_complete_in_idle (ctx->result);
+    if (ctx->cancellable)
+        g_object_unref (ctx->cancellable);
+    g_object_unref (ctx->result);
+    g_object_unref (ctx->self);
+    g_slice_free (OpenContext, ctx);
+}
+
+/**
+ * qmi_device_manager_open_finish:
+ * @self: a #QmiDeviceManager.
+ * @res: a #GAsyncResult.
+ * @error: a #GError.
+ *
+ * Finishes an asynchronous open operation started with qmi_device_manager_open().
+ * Devices which could be open are managed even if an error is returned.
+ *
+ * Returns: #TRUE if all devices were open, #FALSE if @error is set.
+ */
+gboolean
+qmi_device_manager_open_finish (QmiDeviceManager *self,
+                                GAsyncResult *res,
+                                GError **error)
+{
+    return !g_simple_async_result_propagate_error (G_SIMPLE_ASYNC_RESULT (res), error);
+}
+
+static void
+device_open_ready (QmiDevice *device,
+                   GAsyncResult *res,
+                   OpenDeviceContext *device_ctx)
+{
+    OpenContext *ctx = device_ctx->ctx;
+    guint i = device_ctx->i;
+    GError *error = NULL;
+
+    g_slice_free (OpenDeviceContext, device_ctx);
+
+    if (!qmi_device_open_finish (device, res, &error)) {
+        g_prefix_error (&error, "%s: ", qmi_device_get_path_display (device));
+        g_object_unref (device);
+        open_context_device_done (ctx, i, NULL, error);
+        return;
+    }
+
+    open_context_device_done (ctx, i, device, NULL);
+}
+
+static void
+device_new_ready (GObject *unused,
+                  GAsyncResult *res,
+                  OpenDeviceContext *device_ctx)
+{
+    GError *error = NULL;
+    QmiDevice *device;
+
+    device = qmi_device_new_finish (res, &error);
+    if (!device) {
+        open_context_device_done (device_ctx->ctx, device_ctx->i, NULL, error);
+        g_slice_free (OpenDeviceContext, device_ctx);
+        return;
+    }
+
+    qmi_device_open (device,
+                     device_ctx->ctx->flags,
+                     device_ctx->ctx->timeout,
+                     device_ctx->ctx->cancellable,
+                     (GAsyncReadyCallback)device_open_ready,
+                     device_ctx);
+}
+
+/**
+ * qmi_device_manager_open:
+ * @self: a #QmiDeviceManager.
+ * @paths: a #NULL-terminated array of QMI device paths.
+ * @flags: mask of #QmiDeviceOpenFlags specifying how each device should be open.
+ * @timeout: maximum time, in seconds, to wait for each device to be open.
+ * @cancellable: optional #GCancellable object, #NULL to ignore.
+ * @callback: a #GAsyncReadyCallback to call when the operation is finished.
+ * @user_data: the data to pass to callback function.
+ *
+ * Asynchronously creates and opens a #QmiDevice for each of @paths, all of
+ * them at the same time. Unless %QMI_DEVICE_OPEN_FLAGS_IO_THREAD is given,
+ * every device is driven from the thread-default main context of the caller.
+ * The devices are managed in the same order as @paths, with an empty slot
+ * for each one which couldn't be open.
+ *
+ * When the operation is finished @callback will be called. You can then call
+ * qmi_device_manager_open_finish() to get the result of the operation.
+ */
+void
+qmi_device_manager_open (QmiDeviceManager *self,
+                         const gchar * const *paths,
+                         QmiDeviceOpenFlags flags,
+                         guint timeout,
+                         GCancellable *cancellable,
+                         GAsyncReadyCallback callback,
+                         gpointer user_data)
+{
+    OpenContext *ctx;
+    guint first;
+    guint i;
+
+    g_return_if_fail (QMI_IS_DEVICE_MANAGER (self));
+    g_return_if_fail (paths != NULL);
+
+    ctx = g_slice_new0 (OpenContext);
+    ctx->self = g_object_ref (self);
+    ctx->result = g_simple_async_result_new (G_OBJECT (self),
+                                             callback,
+                                             user_data,
+                                             qmi_device_manager_open);
+    ctx->cancellable = (cancellable ? g_object_ref (cancellable) : NULL);
+    ctx->flags = flags;
+    ctx->timeout = timeout;
+    ctx->n_total = g_strv_length ((gchar **)paths);
+
+    /* Hold one extra pending operation until all devices are requested */
+    ctx->n_pending = ctx->n_total + 1;
+
+    /* One slot per path, filled in as the devices get open, so that they
+     * keep the order of the paths whatever the order they are open in */
+    first = self->priv->devices->len;
+    g_ptr_array_set_size (self->priv->devices, first + ctx->n_total);
+
+    for (i = 0; paths[i]; i++) {
+        OpenDeviceContext *device_ctx;
+        GFile *file;
+
+        device_ctx = g_slice_new (OpenDeviceContext);
+        device_ctx->ctx = ctx;
+        device_ctx->i = first + i;
+
+        file = g_file_new_for_path (paths[i]);
+        qmi_device_new (file,
+                        cancellable,
+                        (GAsyncReadyCallback)device_new_ready,
+                        device_ctx);
+        g_object_unref (file);
+    }
+
+    open_context_device_done (ctx, 0, NULL, NULL);
+}
+
+/*****************************************************************************/
+/* Close devices */
+
+/**
+ * qmi_device_manager_close:
+ * @self: a #QmiDeviceManager.
+ * @error: a #GError.
+ *
+ * Synchronously closes all the managed devices and stops managing them.
+ *
+ * Returns: #TRUE if all devices were closed, #FALSE if @error is set.
+ */
+gboolean
+qmi_device_manager_close (QmiDeviceManager *self,
+                          GError **error)
+{
+    GError *inner_error = NULL;
+    guint i;
+
+    g_return_val_if_fail (QMI_IS_DEVICE_MANAGER (self), FALSE);
+
+    for (i = 0; i < self->priv->devices->len; i++) {
+        QmiDevice *device;
+        GError *device_error = NULL;
+
+        device = g_ptr_array_index (self->priv->devices, i);
+        if (!device)
+            continue;
+
+        if (!qmi_device_close (device, &device_error)) {
+            g_prefix_error (&device_error, "%s: ", qmi_device_get_path_display (device));
+            if (!inner_error)
+                inner_error = device_error;
+            else
+                g_error_free (device_error);
+        }
+    }
+
+    g_ptr_array_set_size (self->priv->devices, 0);
+
+    if (inner_error) {
+        g_propagate_error (error, inner_error);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*****************************************************************************/
+/* Run a command in all devices */
+
+typedef struct {
+    QmiDeviceManager *self;
+    GSimpleAsyncResult *result;
+    GPtrArray *replies;
+    guint n_pending;
+    guint n_sent;
+    guint n_failed;
+    GError *error; /* first one found */
+} CommandContext;
+
+typedef struct {
+    CommandContext *ctx;
+    guint i;
+} CommandDeviceContext;
+
+static void
+reply_free (QmiMessage *reply)
+{
+    if (reply)
+        qmi_message_unref (reply);
+}
+
+static void
+command_context_complete_and_free (CommandContext *ctx)
+{
+    /* Only fail if not a single device replied */
+    if (ctx->n_failed > 0 && ctx->n_failed == ctx->n_sent) {
+        g_simple_async_result_take_error (ctx->result, ctx->error);
+        g_ptr_array_unref (ctx->replies);
+    } else {
+        if (ctx->error)
+            g_error_free (ctx->error);
+        g_simple_async_result_set_op_res_gpointer (ctx->result,
+                                                   ctx->replies,
+                                                   (GDestroyNotify)g_ptr_array_unref);
+    }
+
+    g_simple_async_result_complete_in_idle (ctx->result);
+    g_object_unref (ctx->result);
+    g_object_unref (ctx->self);
+    g_slice_free (CommandContext, ctx);
+}
+
+/**
+ * qmi_device_manager_command_finish:
+ * @self: a #QmiDeviceManager.
+ * @res: a #GAsyncResult.
+ * @error: a #GError.
+ *
+ * Finishes an operation started with qmi_device_manager_command().
+ *
+ * Returns: a #GPtrArray with one #QmiMessage reply per managed device, in the
+ * same order as the devices, or #NULL if @error is set. Devices which were
+ * skipped or failed get a #NULL reply. The returned value should be freed
+ * with g_ptr_array_unref().
+ */
+GPtrArray *
+qmi_device_manager_command_finish (QmiDeviceManager *self,
+                                   GAsyncResult *res,
+                                   GError **error)
+{
+    if (g_simple_async_result_propagate_error (G_SIMPLE_ASYNC_RESULT (res), error))
+        return NULL;
+
+    return g_ptr_array_ref (g_simple_async_result_get_op_res_gpointer (
+                                G_SIMPLE_ASYNC_RESULT (res)));
+}
+
+static void
+device_command_ready (QmiDevice *device,
+                      GAsyncResult *res,
+                      CommandDeviceContext *device_ctx)
+{
+    CommandContext *ctx = device_ctx->ctx;
+    GError *error = NULL;
+    QmiMessage *reply;
+
+    reply = qmi_device_command_finish (device, res, &error);
+    if (!reply) {
+        g_debug ("[%s] Command failed: %s",
+                 qmi_device_get_path_display (device),
+                 error->message);
+        ctx->n_failed++;
+        if (!ctx->error)
+            ctx->error = error;
+        else
+            g_error_free (error);
+    } else
+        g_ptr_array_index (ctx->replies, device_ctx->i) = reply;
+
+    g_slice_free (CommandDeviceContext, device_ctx);
+
+    if (--ctx->n_pending == 0)
+        command_context_complete_and_free (ctx);
+}
+
+/**
+ * qmi_device_manager_command:
+ * @self: a #QmiDeviceManager.
+ * @build_message: a #QmiDeviceManagerMessageFunc to build the request for each device.
+ * @build_message_data: the data to pass to @build_message.
+ * @timeout_ms: maximum time to wait for each response, in milliseconds.
+ * @cancellable: optional #GCancellable object, #NULL to ignore.
+ * @callback: a #GAsyncReadyCallback to call when the operation is finished.
+ * @user_data: the data to pass to callback function.
+ *
+ * Sends a request to every managed device at the same time, and collects
+ * all the replies.
+ *
+ * When the operation is finished, @callback will be called. You can then call
+ * qmi_device_manager_command_finish() to get the result of the operation.
+ */
+void
+qmi_device_manager_command (QmiDeviceManager *self,
+                            QmiDeviceManagerMessageFunc build_message,
+                            gpointer build_message_data,
+                            guint timeout_ms,
+                            GCancellable *cancellable,
+                            GAsyncReadyCallback callback,
+                            gpointer user_data)
+{
+    CommandContext *ctx;
+    guint i;
+
+    g_return_if_fail (QMI_IS_DEVICE_MANAGER (self));
+    g_return_if_fail (build_message != NULL);
+
+    ctx = g_slice_new0 (CommandContext);
+    ctx->self = g_object_ref (self);
+    ctx->result = g_simple_async_result_new (G_OBJECT (self),
+                                             callback,
+                                             user_data,
+                                             qmi_device_manager_command);
+    ctx->replies = g_ptr_array_new_with_free_func ((GDestroyNotify)reply_free);
+    g_ptr_array_set_size (ctx->replies, self->priv->devices->len);
+
+    /* Hold one extra pending operation until all requests are sent */
+    ctx->n_pending = 1;
+
+    for (i = 0; i < self->priv->devices->len; i++) {
+        QmiDevice *device;
+        QmiMessage *message;
+        CommandDeviceContext *device_ctx;
+
+        device = g_ptr_array_index (self->priv->devices, i);
+        if (!device)
+            continue;
+
+        message = build_message (device, build_message_data);
+        if (!message)
+            continue;
+
+        device_ctx = g_slice_new (CommandDeviceContext);
+        device_ctx->ctx = ctx;
+        device_ctx->i = i;
+        ctx->n_pending++;
+        ctx->n_sent++;
+
+        qmi_device_command_ms (device,
+                               message,
+                               timeout_ms,
+                               cancellable,
+                               (GAsyncReadyCallback)device_command_ready,
+                               device_ctx);
+        qmi_message_unref (message);
+    }
+
+    if (--ctx->n_pending == 0)
+        command_context_complete_and_free (ctx);
+}
+
+/*****************************************************************************/
+
+/**
+ * qmi_device_manager_new:
+ *
+ * Creates a new #QmiDeviceManager, with no devices.
+ *
+ * Returns: a new #QmiDeviceManager. Free with g_object_unref().
+ */
+QmiDeviceManager *
+qmi_device_manager_new (void)
+{
+    return QMI_DEVICE_MANAGER (g_object_new (QMI_TYPE_DEVICE_MANAGER, NULL));
+}
+
+static void
+qmi_device_manager_init (QmiDeviceManager *self)
+{
+    self->priv = G_TYPE_INSTANCE_GET_PRIVATE ((self),
+                                              QMI_TYPE_DEVICE_MANAGER,
+                                              QmiDeviceManagerPrivate);
+
+    self->priv->devices = g_ptr_array_new_with_free_func ((GDestroyNotify)device_unref);
+}
+
+static void
+finalize (GObject *object)
+{
+    QmiDeviceManager *self = QMI_DEVICE_MANAGER (object);
+
+    g_ptr_array_unref (self->priv->devices);
+
+    G_OBJECT_CLASS (qmi_device_manager_parent_class)->finalize (object);
+}
+
+static void
+qmi_device_manager_class_init (QmiDeviceManagerClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+    g_type_class_add_private (object_class, sizeof (QmiDeviceManagerPrivate));
+
+    object_class->finalize = finalize;
+}
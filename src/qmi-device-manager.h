@@ -0,0 +1,102 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _LIBQMI_GLIB_QMI_DEVICE_MANAGER_H_
+#define _LIBQMI_GLIB_QMI_DEVICE_MANAGER_H_
+
+#include <glib-object.h>
+#include <gio/gio.h>
+
+#include "qmi-device.h"
+
+G_BEGIN_DECLS
+
+#define QMI_TYPE_DEVICE_MANAGER            (qmi_device_manager_get_type ())
+#define QMI_DEVICE_MANAGER(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), QMI_TYPE_DEVICE_MANAGER, QmiDeviceManager))
+#define QMI_DEVICE_MANAGER_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  QMI_TYPE_DEVICE_MANAGER, QmiDeviceManagerClass))
+#define QMI_IS_DEVICE_MANAGER(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), QMI_TYPE_DEVICE_MANAGER))
+#define QMI_IS_DEVICE_MANAGER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  QMI_TYPE_DEVICE_MANAGER))
+#define QMI_DEVICE_MANAGER_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),  QMI_TYPE_DEVICE_MANAGER, QmiDeviceManagerClass))
+
+typedef struct _QmiDeviceManager QmiDeviceManager;
+typedef struct _QmiDeviceManagerClass QmiDeviceManagerClass;
+typedef struct _QmiDeviceManagerPrivate QmiDeviceManagerPrivate;
+
+struct _QmiDeviceManager {
+    GObject parent;
+    QmiDeviceManagerPrivate *priv;
+};
+
+struct _QmiDeviceManagerClass {
+    GObjectClass parent;
+};
+
+GType qmi_device_manager_get_type (void);
+
+QmiDeviceManager *qmi_device_manager_new (void);
+
+void      qmi_device_manager_open        (QmiDeviceManager *self,
+                                          const gchar * const *paths,
+                                          QmiDeviceOpenFlags flags,
+                                          guint timeout,
+                                          GCancellable *cancellable,
+                                          GAsyncReadyCallback callback,
+                                          gpointer user_data);
+gboolean  qmi_device_manager_open_finish (QmiDeviceManager *self,
+                                          GAsyncResult *res,
+                                          GError **error);
+
+gboolean  qmi_device_manager_close (QmiDeviceManager *self,
+                                    GError **error);
+
+guint      qmi_device_manager_get_n_devices (QmiDeviceManager *self);
+QmiDevice *qmi_device_manager_peek_device   (QmiDeviceManager *self,
+                                             guint i);
+
+void qmi_device_manager_get_stats (QmiDeviceManager *self,
+                                   QmiDeviceStats *stats);
+
+/**
+ * QmiDeviceManagerMessageFunc:
+ * @device: a #QmiDevice.
+ * @user_data: the data given to qmi_device_manager_command().
+ *
+ * Builds the request to send to @device, e.g. using the CID of a client
+ * allocated in that device.
+ *
+ * Returns: a new #QmiMessage, or #NULL to skip @device.
+ */
+typedef QmiMessage *(* QmiDeviceManagerMessageFunc) (QmiDevice *device,
+                                                     gpointer user_data);
+
+void       qmi_device_manager_command        (QmiDeviceManager *self,
+                                              QmiDeviceManagerMessageFunc build_message,
+                                              gpointer build_message_data,
+                                              guint timeout_ms,
+                                              GCancellable *cancellable,
+                                              GAsyncReadyCallback callback,
+                                              gpointer user_data);
+GPtrArray *qmi_device_manager_command_finish (QmiDeviceManager *self,
+                                              GAsyncResult *res,
+                                              GError **error);
+
+G_END_DECLS
+
+#endif /* _LIBQMI_GLIB_QMI_DEVICE_MANAGER_H_ */
@@ -25,10 +25,13 @@
 #include <fcntl.h>
 #include <termios.h>
 #include <unistd.h>
+#include <sys/uio.h>
 #include <gio/gio.h>
 
 #include "qmi-device.h"
 #include "qmi-message.h"
+#include "qmi-message-private.h"
+#include "qmi-message-ctl.h"
 #include "qmi-client-ctl.h"
 #include "qmi-client-dms.h"
 #include "qmi-client-wds.h"
@@ -45,11 +48,21 @@ enum {
     PROP_0,
     PROP_FILE,
     PROP_CLIENT_CTL,
+    PROP_BACKPRESSURE,
     PROP_LAST
 };
 
 static GParamSpec *properties[PROP_LAST];
 
+enum {
+    SIGNAL_CLIENT_LOST,
+    SIGNAL_LAST
+};
+
+static guint signals[SIGNAL_LAST];
+
+typedef struct _Transaction Transaction;
+
 struct _QmiDevicePrivate {
     /* File */
     GFile *file;
@@ -62,88 +75,329 @@ struct _QmiDevicePrivate {
     /* Supported services */
     GPtrArray *supported_services;
 
-    /* I/O channel, set when the file is open */
-    GIOChannel *iochannel;
-    guint watch_id;
-    GByteArray *response;
-
-    /* HT to keep track of ongoing transactions */
-    GHashTable *transactions;
+    /* Context where indications are reported, the one the device was
+     * opened from */
+    GMainContext *owner_context;
+
+    /* Optional I/O thread; when set, all the I/O watches and transaction
+     * timeouts run in io_context instead of in the default one */
+    GThread *io_thread;
+    GMainContext *io_context;
+    GMainLoop *io_loop;
+
+    /* Protects the transactions, the registered clients and the I/O
+     * buffers, which the I/O thread shares with the API callers */
+    GMutex mutex;
+
+    /* Device file descriptor, -1 unless the file is open, and the source
+     * polling it */
+    gint fd;
+    GSource *fd_source;
+
+    /* Receive buffer, see data_available() */
+    guint8 *rx_buffer;
+    gsize rx_start;
+    gsize rx_end;
+
+    /* Outbound frames not fully written yet, from tx_head on, see
+     * write_queue_flush() */
+    GArray *tx_frames;
+    guint tx_head;
+    gsize tx_offset; /* bytes of the head message already written */
+    gsize tx_bytes_pending;
+    gboolean tx_blocked; /* waiting for the device to take more */
+    gboolean tx_broken; /* a write failed, the device is being hung up */
+
+    /* Syscalls done and frames received, to check how well reads and
+     * writes are batched */
+    guint64 read_syscalls;
+    guint64 write_syscalls;
+    guint64 frames_received;
+
+    /* Input lost while resynchronising framing, or in invalid messages */
+    guint64 rx_bytes_dropped;
+    guint64 rx_frames_dropped;
+
+    /* When set, transactions completed while reading are collected in
+     * completed_results and completed right after, in the same dispatch;
+     * the array is reused in every dispatch */
+    gboolean direct_completion;
+    gboolean collect_results;
+    GPtrArray *completed_results;
+
+    /* Auto-reconnect: after a hangup, the file is reopened as soon as the
+     * parent directory monitor sees it again, or else with exponential
+     * backoff; once the modem answers, the CID of every client is probed
+     * before user commands are accepted again. Replies of attempts older
+     * than reconnect_attempt are ignored. */
+    gboolean auto_reconnect;
+    gboolean reconnect_pending;
+    guint reconnect_attempt;
+    guint reconnect_probes;
+    GSource *reconnect_source;
+    GFileMonitor *reconnect_monitor;
+    guint reconnect_backoff_ms;
+    gint64 hangup_time;
+    guint reconnects;
+    guint64 last_reconnect_time;
+
+    /* Optional pool of received messages */
+    QmiMessagePool *message_pool;
+
+    /* Open-addressed table of ongoing transactions, holding the records
+     * themselves, and the serial given to the last one stored */
+    Transaction *transactions;
+    guint transactions_size;
+    guint n_transactions;
+    guint transaction_serial;
+
+    /* In-flight window: transactions sent and not yet completed, counted
+     * per client and per service. Those beyond the window wait in the
+     * pending queue until earlier ones complete. A max of 0 means there is
+     * no limit. */
+    guint max_in_flight_per_client;
+    guint max_in_flight_per_service;
+    guint n_in_flight;
+    guint service_in_flight[G_MAXUINT8 + 1];
+    GHashTable *client_in_flight;
+    GQueue pending_queue;
+    gboolean backpressure;
+
+    /* Min-heap of transactions by deadline, and the single source firing
+     * their timeouts */
+    GPtrArray *timeouts;
+    GSource *timeout_source;
 
     /* HT of clients that want to get indications */
     GHashTable *registered_clients;
+    /* Same clients indexed by service, for broadcast indications; the
+     * references are owned by registered_clients */
+    GHashTable *service_clients;
+
+    /* Indications waiting to be passed to the clients, all of them in a
+     * single idle */
+    GQueue indication_queue;
+    guint indication_idle_pending : 1;
 };
 
-#define BUFFER_SIZE 2048
+/* Max number of queued frames given to a single writev() */
+#define TX_MAX_IOV 16
+
+/* Frames waiting in the write queue */
+#define TX_QUEUE_LENGTH(self) ((self)->priv->tx_frames->len - (self)->priv->tx_head)
+
+/* Large enough for the biggest QMUX frame: the marker plus a 16-bit length */
+#define RX_BUFFER_SIZE (G_MAXUINT16 + 1)
+
+/* Backoff between attempts to reopen the device after a hangup, and time
+ * given to the modem to answer each check once reopened */
+#define RECONNECT_BACKOFF_INITIAL_MS 100
+#define RECONNECT_BACKOFF_MAX_MS     30000
+#define RECONNECT_CHECK_TIMEOUT_MS   5000
+
+/* Request used to probe the CIDs of the clients after a reconnection; "Get
+ * Supported Messages" exists in every service, and any reply other than
+ * an invalid client ID error shows the CID is still valid */
+#define RECONNECT_PROBE_MESSAGE_ID 0x001E
+
+/* Pooled message blocks fit the frames of most responses and indications */
+#define MESSAGE_POOL_BLOCK_SIZE 512
+#define MESSAGE_POOL_MAX_FREE   64
+
+/*****************************************************************************/
+/* I/O sources, attached to the I/O thread context if there is one */
+
+static guint
+device_attach_source (QmiDevice *self,
+                      GSource *source)
+{
+    guint id;
+
+    id = g_source_attach (source, self->priv->io_context);
+    g_source_unref (source);
+    return id;
+}
+
+static gpointer
+io_thread_func (GMainLoop *loop)
+{
+    GMainContext *context;
+
+    context = g_main_loop_get_context (loop);
+    g_main_context_push_thread_default (context);
+    g_main_loop_run (loop);
+    g_main_context_pop_thread_default (context);
+    g_main_loop_unref (loop);
+    return NULL;
+}
+
+static void
+io_thread_start (QmiDevice *self)
+{
+    self->priv->io_context = g_main_context_new ();
+    self->priv->io_loop = g_main_loop_new (self->priv->io_context, FALSE);
+    self->priv->io_thread = g_thread_new ("qmi-device-io",
+                                          (GThreadFunc)io_thread_func,
+                                          g_main_loop_ref (self->priv->io_loop));
+}
+
+static gboolean
+io_thread_quit (GMainLoop *loop)
+{
+    g_main_loop_quit (loop);
+    return FALSE;
+}
+
+static void
+io_thread_stop (QmiDevice *self)
+{
+    GSource *source;
+
+    if (g_thread_self () == self->priv->io_thread) {
+        /* The last reference to the device was dropped in the I/O thread,
+         * from one of its sources; the loop stops as soon as that dispatch
+         * returns, and the thread cleans up after itself */
+        g_main_loop_quit (self->priv->io_loop);
+        g_thread_unref (self->priv->io_thread);
+    } else {
+        /* Quit from within the loop, so that it works even if the thread
+         * didn't get to run it yet */
+        source = g_idle_source_new ();
+        g_source_set_callback (source,
+                               (GSourceFunc)io_thread_quit,
+                               g_main_loop_ref (self->priv->io_loop),
+                               (GDestroyNotify)g_main_loop_unref);
+        device_attach_source (self, source);
+        g_thread_join (self->priv->io_thread);
+    }
+
+    g_main_loop_unref (self->priv->io_loop);
+    g_main_context_unref (self->priv->io_context);
+    self->priv->io_thread = NULL;
+    self->priv->io_loop = NULL;
+    self->priv->io_context = NULL;
+}
 
 /*****************************************************************************/
 /* Message transactions (private) */
 
-typedef struct {
+struct _Transaction {
+    QmiDevice *self; /* NULL in the free slots of the transaction table */
     QmiMessage *message;
     GSimpleAsyncResult *result;
-    guint timeout_id;
-} Transaction;
+    guint32 key; /* service, client id and transaction id */
+    guint serial; /* tells apart transactions reusing the same key */
+    gint64 deadline; /* monotonic time, in microseconds */
+    guint timeout_index; /* position in the timeouts heap plus one; 0 if not there */
+    GCancellable *cancellable;
+    gulong cancellable_id;
+    GList *pending_link; /* in the pending queue, waiting to be sent */
+    gboolean in_flight;
+    gconstpointer raw; /* frame to write, taken when the message was checked */
+    gsize raw_len;
+    gboolean direct; /* may be completed right when its reply is read */
+};
 
-static Transaction *
-transaction_new (QmiDevice *self,
-                 QmiMessage *message,
-                 GAsyncReadyCallback callback,
-                 gpointer user_data)
+static void timeouts_remove (QmiDevice *self,
+                             Transaction *tr);
+static void in_flight_remove (QmiDevice *self,
+                              Transaction *tr);
+static void backpressure_update (QmiDevice *self);
+static void pending_queue_pump (QmiDevice *self);
+static inline guint32 build_transaction_key (QmiMessage *message);
+
+/* Records are built by the caller and copied into the transaction table
+ * once stored, see device_store_transaction(). Must be called with the
+ * device mutex held. */
+static void
+transaction_init (Transaction *tr,
+                  QmiDevice *self,
+                  QmiMessage *message,
+                  GAsyncReadyCallback callback,
+                  gpointer user_data)
 {
-    Transaction *tr;
-
-    tr = g_slice_new0 (Transaction);
+    memset (tr, 0, sizeof (Transaction));
+    tr->self = self; /* the result keeps a reference */
     tr->message = qmi_message_ref (message);
+    tr->key = build_transaction_key (message);
     tr->result = g_simple_async_result_new (G_OBJECT (self),
                                             callback,
                                             user_data,
-                                            transaction_new);
+                                            transaction_init);
 
-    return tr;
+    /* The result must be completed in the context it was created in, which
+     * is the one the reply is read in only if the request was issued from
+     * the context the device was opened from */
+    if (self->priv->direct_completion) {
+        GMainContext *context;
+
+        context = g_main_context_get_thread_default ();
+        tr->direct = ((context ? context : g_main_context_default ()) == self->priv->owner_context);
+    }
 }
 
+/* Completes a transaction already taken out of the table, or never stored
+ * in it */
 static void
-transaction_complete_and_free (Transaction *tr,
-                               QmiMessage *reply,
-                               const GError *error)
+transaction_complete (Transaction *tr,
+                      QmiMessage *reply,
+                      const GError *error)
 {
     g_assert (reply != NULL || error != NULL);
 
-    if (tr->timeout_id)
-        g_source_remove (tr->timeout_id);
+    if (tr->timeout_index)
+        timeouts_remove (tr->self, tr);
+
+    if (tr->pending_link) {
+        g_queue_delete_link (&tr->self->priv->pending_queue, tr->pending_link);
+        backpressure_update (tr->self);
+    } else if (tr->in_flight)
+        in_flight_remove (tr->self, tr);
+
+    if (tr->cancellable) {
+        /* The cancelled handler never takes the device mutex, so waiting for
+         * it to finish here cannot deadlock */
+        if (tr->cancellable_id)
+            g_cancellable_disconnect (tr->cancellable, tr->cancellable_id);
+        g_object_unref (tr->cancellable);
+    }
 
-    if (reply)
+    if (reply) {
+        /* The reply may be completed in another thread; it must not share
+         * the receive buffer with the I/O thread by then */
+        qmi_message_detach_borrowed (reply);
         g_simple_async_result_set_op_res_gpointer (tr->result,
                                                    qmi_message_ref (reply),
                                                    (GDestroyNotify)qmi_message_unref);
-    else
+    } else
         g_simple_async_result_set_from_error (tr->result, error);
 
-    g_simple_async_result_complete_in_idle (tr->result);
-    g_object_unref (tr->result);
+    if (tr->direct && tr->self->priv->collect_results)
+        /* The list takes over our reference */
+        g_ptr_array_add (tr->self->priv->completed_results, tr->result);
+    else {
+        g_simple_async_result_complete_in_idle (tr->result);
+        g_object_unref (tr->result);
+    }
     qmi_message_unref (tr->message);
-    g_slice_free (Transaction, tr);
 }
 
-static inline gpointer
+static inline guint32
 build_transaction_key (QmiMessage *message)
 {
-    gpointer key;
-    guint8 service;
-    guint8 client_id;
-    guint16 transaction_id;
+    guint32 key;
+    const QmiMessageHeader *header;
 
-    service = (guint8)qmi_message_get_service (message);
-    client_id = qmi_message_get_client_id (message);
-    transaction_id = qmi_message_get_transaction_id (message);
+    header = QMI_MESSAGE_HEADER (message);
 
-    /* We're putting a 32 bit value into a gpointer */
-    key = GUINT_TO_POINTER ((((service << 8) | client_id) << 16) | transaction_id);
+    key = (((header->service << 8) | header->client_id) << 16) | header->transaction_id;
 
 #ifdef MESSAGE_ENABLE_TRACE
     {
         gchar *hex;
+        guint8 service = header->service;
+        guint8 client_id = header->client_id;
+        guint16 transaction_id = header->transaction_id;
 
         hex = qmi_utils_str_hex (&key, sizeof (key), ':');
         g_debug ("KEY: %s", hex);
@@ -166,84 +420,587 @@ build_transaction_key (QmiMessage *message)
     return key;
 }
 
+/* Ongoing transactions are kept inline in an open-addressed table with
+ * linear probing, which only grows once it gets 3/4 full. Removing an entry
+ * shifts back the ones after it instead of leaving tombstones. Records move
+ * whenever that happens or the table grows, so pointers to them are only
+ * valid until the table is modified again; the timeouts heap and the pending
+ * queue, which refer to them, are fixed up on every move. All these must be
+ * called with the device mutex held. */
+
+#define TRANSACTION_TABLE_INITIAL_SIZE 64
+
+#define TRANSACTION_AT(self, i) (&(self)->priv->transactions[(i)])
+#define TRANSACTION_SLOT_USED(tr) ((tr)->self != NULL)
+
+static inline guint
+transaction_table_home (QmiDevice *self,
+                        guint32 key)
+{
+    /* Mix the service and client bits into the transaction id ones */
+    key ^= key >> 16;
+    key *= 0x45d9f3b;
+    key ^= key >> 16;
+    return key & (self->priv->transactions_size - 1);
+}
+
+/* Points whatever refers to the record to its new location */
+static inline void
+transaction_moved (QmiDevice *self,
+                   Transaction *tr)
+{
+    if (tr->timeout_index)
+        g_ptr_array_index (self->priv->timeouts, tr->timeout_index - 1) = tr;
+    if (tr->pending_link)
+        tr->pending_link->data = tr;
+}
+
 static Transaction *
-device_release_transaction (QmiDevice *self,
-                            gpointer key)
+transaction_table_insert_unchecked (QmiDevice *self,
+                                    const Transaction *tr)
 {
-    Transaction *tr = NULL;
+    guint i;
 
-    if (self->priv->transactions) {
-        tr = g_hash_table_lookup (self->priv->transactions, key);
-        if (tr)
-            /* If found, remove it from the HT */
-            g_hash_table_remove (self->priv->transactions, key);
+    for (i = transaction_table_home (self, tr->key);
+         TRANSACTION_SLOT_USED (TRANSACTION_AT (self, i));
+         i = (i + 1) & (self->priv->transactions_size - 1));
+    *TRANSACTION_AT (self, i) = *tr;
+    return TRANSACTION_AT (self, i);
+}
+
+static Transaction *
+transaction_table_insert (QmiDevice *self,
+                          const Transaction *tr)
+{
+    if ((self->priv->n_transactions + 1) * 4 > self->priv->transactions_size * 3) {
+        Transaction *old;
+        guint old_size;
+        guint i;
+
+        old = self->priv->transactions;
+        old_size = self->priv->transactions_size;
+
+        self->priv->transactions_size = old_size * 2;
+        self->priv->transactions = g_new0 (Transaction, self->priv->transactions_size);
+        for (i = 0; i < old_size; i++) {
+            if (TRANSACTION_SLOT_USED (&old[i]))
+                transaction_moved (self, transaction_table_insert_unchecked (self, &old[i]));
+        }
+        g_free (old);
     }
 
-    return tr;
+    self->priv->n_transactions++;
+    return transaction_table_insert_unchecked (self, tr);
+}
+
+/* Looks for the transaction with the given key and serial, or for the oldest
+ * one with the given key if @serial is 0. Returns its position, or -1. */
+static gint
+transaction_table_find (QmiDevice *self,
+                        guint32 key,
+                        guint serial)
+{
+    guint i;
+
+    if (!self->priv->transactions)
+        return -1;
+
+    for (i = transaction_table_home (self, key);
+         TRANSACTION_SLOT_USED (TRANSACTION_AT (self, i));
+         i = (i + 1) & (self->priv->transactions_size - 1)) {
+        if (TRANSACTION_AT (self, i)->key == key &&
+            (!serial || TRANSACTION_AT (self, i)->serial == serial))
+            return (gint)i;
+    }
+
+    return -1;
+}
+
+/* Moves the transaction at the given position out of the table, into @tr,
+ * taking it out of the timeouts heap and of the pending queue as well */
+static void
+transaction_table_take (QmiDevice *self,
+                        guint i,
+                        Transaction *tr)
+{
+    Transaction *slot;
+    guint mask;
+    guint j;
+
+    slot = TRANSACTION_AT (self, i);
+    if (slot->timeout_index)
+        timeouts_remove (self, slot);
+    if (slot->pending_link) {
+        g_queue_delete_link (&self->priv->pending_queue, slot->pending_link);
+        slot->pending_link = NULL;
+        backpressure_update (self);
+    }
+
+    *tr = *slot;
+    slot->self = NULL;
+    self->priv->n_transactions--;
+
+    /* Fill the hole with the entries which would otherwise not be found
+     * past it, i.e. those whose home position isn't between the hole and
+     * their current one */
+    mask = self->priv->transactions_size - 1;
+    for (j = (i + 1) & mask; TRANSACTION_SLOT_USED (TRANSACTION_AT (self, j)); j = (j + 1) & mask) {
+        guint home;
+
+        home = transaction_table_home (self, TRANSACTION_AT (self, j)->key);
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            *TRANSACTION_AT (self, i) = *TRANSACTION_AT (self, j);
+            TRANSACTION_AT (self, j)->self = NULL;
+            transaction_moved (self, TRANSACTION_AT (self, i));
+            i = j;
+        }
+    }
+}
+
+/* Transaction timeouts are kept in a binary min-heap ordered by deadline,
+ * so that both adding and removing one are O(log n). A single source per
+ * device wakes up when the earliest deadline is reached. All these must be
+ * called with the device mutex held. */
+
+#define TIMEOUT_AT(self, i) ((Transaction *)g_ptr_array_index ((self)->priv->timeouts, (i)))
+
+static inline void
+timeouts_set (QmiDevice *self,
+              guint i,
+              Transaction *tr)
+{
+    g_ptr_array_index (self->priv->timeouts, i) = tr;
+    tr->timeout_index = i + 1;
+}
+
+static void
+timeouts_sift_up (QmiDevice *self,
+                  guint i)
+{
+    Transaction *tr;
+
+    tr = TIMEOUT_AT (self, i);
+    while (i > 0) {
+        guint parent;
+
+        parent = (i - 1) / 2;
+        if (TIMEOUT_AT (self, parent)->deadline <= tr->deadline)
+            break;
+        timeouts_set (self, i, TIMEOUT_AT (self, parent));
+        i = parent;
+    }
+    timeouts_set (self, i, tr);
+}
+
+static void
+timeouts_sift_down (QmiDevice *self,
+                    guint i)
+{
+    Transaction *tr;
+    guint n;
+
+    n = self->priv->timeouts->len;
+    tr = TIMEOUT_AT (self, i);
+    for (;;) {
+        guint child;
+
+        child = 2 * i + 1;
+        if (child >= n)
+            break;
+        if (child + 1 < n &&
+            TIMEOUT_AT (self, child + 1)->deadline < TIMEOUT_AT (self, child)->deadline)
+            child++;
+        if (tr->deadline <= TIMEOUT_AT (self, child)->deadline)
+            break;
+        timeouts_set (self, i, TIMEOUT_AT (self, child));
+        i = child;
+    }
+    timeouts_set (self, i, tr);
+}
+
+static void
+timeouts_add (QmiDevice *self,
+              Transaction *tr)
+{
+    g_ptr_array_add (self->priv->timeouts, tr);
+    timeouts_sift_up (self, self->priv->timeouts->len - 1);
+
+    /* A new earliest deadline; the loop may be sleeping on an older one */
+    if (tr->timeout_index == 1 && self->priv->io_context)
+        g_main_context_wakeup (self->priv->io_context);
+}
+
+static void
+timeouts_remove (QmiDevice *self,
+                 Transaction *tr)
+{
+    guint i;
+    Transaction *last;
+
+    i = tr->timeout_index - 1;
+    tr->timeout_index = 0;
+
+    last = g_ptr_array_remove_index (self->priv->timeouts, self->priv->timeouts->len - 1);
+    if (last == tr)
+        return;
+
+    /* Fill the hole with the last element, and restore the heap order */
+    timeouts_set (self, i, last);
+    if (i > 0 && TIMEOUT_AT (self, (i - 1) / 2)->deadline > last->deadline)
+        timeouts_sift_up (self, i);
+    else
+        timeouts_sift_down (self, i);
 }
 
 typedef struct {
+    GSource source;
     QmiDevice *self;
-    gpointer key;
-} TransactionTimeoutContext;
+} TimeoutSource;
 
-static void
-transaction_timeout_context_free (TransactionTimeoutContext *ctx)
+static gboolean
+timeout_source_prepare (GSource *source,
+                        gint *timeout)
+{
+    QmiDevice *self = ((TimeoutSource *)source)->self;
+    gboolean ready = FALSE;
+
+    *timeout = -1;
+
+    g_mutex_lock (&self->priv->mutex);
+    if (self->priv->timeouts->len > 0) {
+        gint64 remaining;
+
+        remaining = TIMEOUT_AT (self, 0)->deadline - g_source_get_time (source);
+        if (remaining <= 0) {
+            *timeout = 0;
+            ready = TRUE;
+        } else
+            /* Round up, so that we don't wake up right before the deadline */
+            *timeout = (gint) MIN ((remaining + 999) / 1000, G_MAXINT);
+    }
+    g_mutex_unlock (&self->priv->mutex);
+
+    return ready;
+}
+
+static gboolean
+timeout_source_check (GSource *source)
 {
-    g_slice_free (TransactionTimeoutContext, ctx);
+    QmiDevice *self = ((TimeoutSource *)source)->self;
+    gboolean ready;
+
+    g_mutex_lock (&self->priv->mutex);
+    ready = (self->priv->timeouts->len > 0 &&
+             TIMEOUT_AT (self, 0)->deadline <= g_source_get_time (source));
+    g_mutex_unlock (&self->priv->mutex);
+
+    return ready;
 }
 
 static gboolean
-transaction_timed_out (TransactionTimeoutContext *ctx)
+timeout_source_dispatch (GSource *source,
+                         GSourceFunc callback,
+                         gpointer user_data)
+{
+    QmiDevice *self = ((TimeoutSource *)source)->self;
+    gint64 now;
+
+    now = g_source_get_time (source);
+
+    g_mutex_lock (&self->priv->mutex);
+    while (self->priv->timeouts->len > 0 &&
+           TIMEOUT_AT (self, 0)->deadline <= now) {
+        Transaction tr;
+        GError *error;
+
+        transaction_table_take (self, (guint)(TIMEOUT_AT (self, 0) - self->priv->transactions), &tr);
+
+        /* Complete transaction with a timeout error */
+        error = g_error_new (QMI_CORE_ERROR,
+                             QMI_CORE_ERROR_TIMEOUT,
+                             "Transaction timed out");
+        transaction_complete (&tr, NULL, error);
+        g_error_free (error);
+    }
+    pending_queue_pump (self);
+    g_mutex_unlock (&self->priv->mutex);
+
+    return TRUE;
+}
+
+static GSourceFuncs timeout_source_funcs = {
+    timeout_source_prepare,
+    timeout_source_check,
+    timeout_source_dispatch,
+    NULL
+};
+
+/* Copies the transaction into the table, and returns the stored record */
+static Transaction *
+device_store_transaction (QmiDevice *self,
+                          const Transaction *record,
+                          guint timeout_ms)
 {
     Transaction *tr;
-    GError *error = NULL;
 
-    tr = device_release_transaction (ctx->self, ctx->key);
-    tr->timeout_id = 0;
+    if (G_UNLIKELY (!self->priv->transactions)) {
+        GSource *source;
+
+        self->priv->transactions_size = TRANSACTION_TABLE_INITIAL_SIZE;
+        self->priv->transactions = g_new0 (Transaction, TRANSACTION_TABLE_INITIAL_SIZE);
+        self->priv->timeouts = g_ptr_array_new ();
+
+        /* Kept around until the device is disposed */
+        source = g_source_new (&timeout_source_funcs, sizeof (TimeoutSource));
+        ((TimeoutSource *)source)->self = self;
+        g_source_attach (source, self->priv->io_context);
+        self->priv->timeout_source = source;
+    }
+
+    tr = transaction_table_insert (self, record);
+    if (G_UNLIKELY (++self->priv->transaction_serial == 0))
+        self->priv->transaction_serial = 1;
+    tr->serial = self->priv->transaction_serial;
+
+    /* Once it gets into the table, setup the timeout */
+    tr->deadline = g_get_monotonic_time () + (gint64)timeout_ms * 1000;
+    timeouts_add (self, tr);
+
+    return tr;
+}
+
+/* In-flight window accounting. All these must be called with the device
+ * mutex held. */
+
+#define IN_FLIGHT_CLIENT_KEY(header) GUINT_TO_POINTER (((header)->service << 8) | (header)->client_id)
+
+static gboolean
+in_flight_window_allows (QmiDevice *self,
+                         Transaction *tr)
+{
+    const QmiMessageHeader *header;
+
+    header = QMI_MESSAGE_HEADER (tr->message);
+
+    if (self->priv->max_in_flight_per_service &&
+        self->priv->service_in_flight[header->service] >= self->priv->max_in_flight_per_service)
+        return FALSE;
+
+    if (self->priv->max_in_flight_per_client &&
+        GPOINTER_TO_UINT (g_hash_table_lookup (self->priv->client_in_flight,
+                                               IN_FLIGHT_CLIENT_KEY (header))) >= self->priv->max_in_flight_per_client)
+        return FALSE;
+
+    return TRUE;
+}
+
+static void
+in_flight_add (QmiDevice *self,
+               Transaction *tr)
+{
+    const QmiMessageHeader *header;
+    guint n;
+
+    header = QMI_MESSAGE_HEADER (tr->message);
+
+    n = GPOINTER_TO_UINT (g_hash_table_lookup (self->priv->client_in_flight,
+                                               IN_FLIGHT_CLIENT_KEY (header)));
+    g_hash_table_insert (self->priv->client_in_flight,
+                         IN_FLIGHT_CLIENT_KEY (header),
+                         GUINT_TO_POINTER (n + 1));
+    self->priv->service_in_flight[header->service]++;
+    self->priv->n_in_flight++;
+    tr->in_flight = TRUE;
+}
 
-    /* Complete transaction with a timeout error */
-    error = g_error_new (QMI_CORE_ERROR,
-                         QMI_CORE_ERROR_TIMEOUT,
-                         "Transaction timed out");
-    transaction_complete_and_free (tr, NULL, error);
-    g_error_free (error);
+static void
+in_flight_remove (QmiDevice *self,
+                  Transaction *tr)
+{
+    const QmiMessageHeader *header;
+    guint n;
+
+    header = QMI_MESSAGE_HEADER (tr->message);
+
+    n = GPOINTER_TO_UINT (g_hash_table_lookup (self->priv->client_in_flight,
+                                               IN_FLIGHT_CLIENT_KEY (header)));
+    g_assert (n > 0);
+    if (n > 1)
+        g_hash_table_insert (self->priv->client_in_flight,
+                             IN_FLIGHT_CLIENT_KEY (header),
+                             GUINT_TO_POINTER (n - 1));
+    else
+        g_hash_table_remove (self->priv->client_in_flight,
+                             IN_FLIGHT_CLIENT_KEY (header));
+    self->priv->service_in_flight[header->service]--;
+    self->priv->n_in_flight--;
+    tr->in_flight = FALSE;
+}
 
+static gboolean
+backpressure_notify_idle (QmiDevice *self)
+{
+    g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_BACKPRESSURE]);
+    g_object_unref (self);
     return FALSE;
 }
 
+/* Backpressure is on while there are requests waiting for the window; the
+ * property is notified in the context the device was opened from */
 static void
-device_store_transaction (QmiDevice *self,
-                          Transaction *tr,
-                          guint timeout)
+backpressure_update (QmiDevice *self)
 {
-    TransactionTimeoutContext *timeout_ctx;
-    gpointer key;
+    gboolean backpressure;
+    GSource *source;
 
-    if (G_UNLIKELY (!self->priv->transactions))
-        self->priv->transactions = g_hash_table_new (g_direct_hash,
-                                                     g_direct_equal);
+    backpressure = !g_queue_is_empty (&self->priv->pending_queue);
+    if (backpressure == self->priv->backpressure)
+        return;
 
-    key = build_transaction_key (tr->message);
-    g_hash_table_insert (self->priv->transactions, key, tr);
+    self->priv->backpressure = backpressure;
 
-    /* Once it gets into the HT, setup the timeout */
-    timeout_ctx = g_slice_new (TransactionTimeoutContext);
-    timeout_ctx->self = self;
-    timeout_ctx->key = key; /* valid as long as the transaction is in the HT */
-    tr->timeout_id = g_timeout_add_seconds_full (G_PRIORITY_DEFAULT,
-                                                 timeout,
-                                                 (GSourceFunc)transaction_timed_out,
-                                                 timeout_ctx,
-                                                 (GDestroyNotify)transaction_timeout_context_free);
+    source = g_idle_source_new ();
+    g_source_set_callback (source,
+                           (GSourceFunc)backpressure_notify_idle,
+                           g_object_ref (self),
+                           NULL);
+    g_source_attach (source, self->priv->owner_context);
+    g_source_unref (source);
 }
 
-static Transaction *
+/* Cancellation. The "cancelled" handler may run in any thread, even
+ * synchronously from g_cancellable_connect(), so it only schedules the actual
+ * work in the device context; the transaction is then looked up again by its
+ * key and serial, and completed only if it is still pending. */
+
+typedef struct {
+    QmiDevice *self;
+    guint32 key;
+    guint serial;
+} TransactionCancelContext;
+
+static void
+transaction_cancel_context_free (TransactionCancelContext *ctx)
+{
+    g_slice_free (TransactionCancelContext, ctx);
+}
+
+static gboolean
+transaction_cancel_idle (TransactionCancelContext *ctx)
+{
+    QmiDevice *self = ctx->self;
+    gint i;
+
+    g_mutex_lock (&self->priv->mutex);
+
+    /* A newer transaction may be using the same key after the transaction
+     * ids wrapped around, so match the serial as well */
+    i = transaction_table_find (self, ctx->key, ctx->serial);
+    if (i >= 0) {
+        Transaction tr;
+        GError *error;
+
+        transaction_table_take (self, (guint)i, &tr);
+        error = g_error_new (G_IO_ERROR,
+                             G_IO_ERROR_CANCELLED,
+                             "Transaction cancelled");
+        transaction_complete (&tr, NULL, error);
+        g_error_free (error);
+        pending_queue_pump (self);
+    }
+
+    g_mutex_unlock (&self->priv->mutex);
+
+    g_object_unref (self);
+    transaction_cancel_context_free (ctx);
+    return FALSE;
+}
+
+static void
+transaction_cancelled (GCancellable *cancellable,
+                       TransactionCancelContext *ctx)
+{
+    TransactionCancelContext *idle_ctx;
+    GSource *source;
+
+    idle_ctx = g_slice_new (TransactionCancelContext);
+    idle_ctx->self = g_object_ref (ctx->self);
+    idle_ctx->key = ctx->key;
+    idle_ctx->serial = ctx->serial;
+
+    source = g_idle_source_new ();
+    g_source_set_callback (source,
+                           (GSourceFunc)transaction_cancel_idle,
+                           idle_ctx,
+                           NULL);
+    g_source_attach (source, ctx->self->priv->io_context);
+    g_source_unref (source);
+}
+
+/* Must be called with the device mutex held, once the transaction is in the
+ * table */
+static void
+transaction_watch_cancellable (Transaction *tr,
+                               GCancellable *cancellable)
+{
+    TransactionCancelContext *ctx;
+
+    ctx = g_slice_new (TransactionCancelContext);
+    ctx->self = tr->self;
+    ctx->key = tr->key;
+    ctx->serial = tr->serial;
+
+    tr->cancellable = g_object_ref (cancellable);
+    tr->cancellable_id = g_cancellable_connect (cancellable,
+                                                G_CALLBACK (transaction_cancelled),
+                                                ctx,
+                                                (GDestroyNotify)transaction_cancel_context_free);
+}
+
+/* Empties the transaction table, completing every transaction with the given
+ * error. Timeouts are dropped in bulk instead of one by one. Must be called
+ * with the device mutex held. */
+static void
+transactions_fail_all (QmiDevice *self,
+                       const GError *error)
+{
+    guint i;
+
+    if (!self->priv->n_transactions)
+        return;
+
+    for (i = 0; i < self->priv->timeouts->len; i++)
+        TIMEOUT_AT (self, i)->timeout_index = 0;
+    g_ptr_array_set_size (self->priv->timeouts, 0);
+
+    for (i = 0; i < self->priv->transactions_size; i++) {
+        Transaction tr;
+
+        if (!TRANSACTION_SLOT_USED (TRANSACTION_AT (self, i)))
+            continue;
+
+        tr = *TRANSACTION_AT (self, i);
+        TRANSACTION_AT (self, i)->self = NULL;
+        transaction_complete (&tr, NULL, error);
+    }
+    self->priv->n_transactions = 0;
+}
+
+/* Takes the transaction matching the message out of the table, into @tr */
+static gboolean
 device_match_transaction (QmiDevice *self,
-                          QmiMessage *message)
+                          QmiMessage *message,
+                          Transaction *tr)
 {
+    gint i;
+
     /* msg can be either the original message or the response */
-    return device_release_transaction (self, build_transaction_key (message));
+    i = transaction_table_find (self, build_transaction_key (message), 0);
+    if (i < 0)
+        return FALSE;
+
+    transaction_table_take (self, (guint)i, tr);
+    return TRUE;
 }
 
 /*****************************************************************************/
@@ -331,31 +1088,123 @@ qmi_device_is_open (QmiDevice *self)
 {
     g_return_val_if_fail (QMI_IS_DEVICE (self), FALSE);
 
-    return !!self->priv->iochannel;
+    return self->priv->fd >= 0;
 }
 
 /*****************************************************************************/
-/* Register/Unregister clients that want to receive indications */
 
-static gpointer
-build_registered_client_key (guint8 cid,
-                             QmiService service)
+/**
+ * qmi_device_get_stats:
+ * @self: a #QmiDevice.
+ * @stats: a #QmiDeviceStats to fill in.
+ *
+ * Get the I/O statistics of the device.
+ */
+void
+qmi_device_get_stats (QmiDevice *self,
+                      QmiDeviceStats *stats)
 {
-    return GUINT_TO_POINTER (((guint8)service << 8) | cid);
+    g_return_if_fail (QMI_IS_DEVICE (self));
+    g_return_if_fail (stats != NULL);
+
+    memset (stats, 0, sizeof (QmiDeviceStats));
+
+    g_mutex_lock (&self->priv->mutex);
+    stats->write_queue_depth = TX_QUEUE_LENGTH (self);
+    stats->write_bytes_pending = self->priv->tx_bytes_pending;
+    stats->rx_bytes_dropped = self->priv->rx_bytes_dropped;
+    stats->rx_frames_dropped = self->priv->rx_frames_dropped;
+    stats->read_syscalls = self->priv->read_syscalls;
+    stats->write_syscalls = self->priv->write_syscalls;
+    stats->frames_received = self->priv->frames_received;
+    stats->reconnects = self->priv->reconnects;
+    stats->last_reconnect_time = self->priv->last_reconnect_time;
+    stats->in_flight = self->priv->n_in_flight;
+    stats->pending_queue_depth = g_queue_get_length (&self->priv->pending_queue);
+    g_mutex_unlock (&self->priv->mutex);
+
+    if (self->priv->message_pool)
+        qmi_message_pool_get_stats (self->priv->message_pool,
+                                    &stats->message_pool_hits,
+                                    &stats->message_pool_misses,
+                                    NULL);
 }
 
-static gboolean
-register_client (QmiDevice *self,
-                 QmiClient *client,
-                 GError **error)
+/**
+ * qmi_device_set_in_flight_window:
+ * @self: a #QmiDevice.
+ * @max_per_client: maximum number of transactions a single client may have sent and not completed, or 0 for no limit.
+ * @max_per_service: maximum number of transactions all clients of a service may have sent and not completed, or 0 for no limit.
+ *
+ * Limits the number of requests outstanding in the device. Requests beyond
+ * these limits are queued and sent as earlier ones complete; their timeouts
+ * include the time spent in that queue.
+ */
+void
+qmi_device_set_in_flight_window (QmiDevice *self,
+                                 guint max_per_client,
+                                 guint max_per_service)
 {
-    gpointer key;
+    g_return_if_fail (QMI_IS_DEVICE (self));
+
+    g_mutex_lock (&self->priv->mutex);
+    self->priv->max_in_flight_per_client = max_per_client;
+    self->priv->max_in_flight_per_service = max_per_service;
+    pending_queue_pump (self);
+    g_mutex_unlock (&self->priv->mutex);
+}
+
+/**
+ * qmi_device_get_backpressure:
+ * @self: a #QmiDevice.
+ *
+ * Checks whether there are requests waiting for room in the in-flight
+ * window. Changes are notified through the #QmiDevice:device-backpressure
+ * property.
+ *
+ * Returns: #TRUE if requests are being held back, #FALSE otherwise.
+ */
+gboolean
+qmi_device_get_backpressure (QmiDevice *self)
+{
+    gboolean backpressure;
+
+    g_return_val_if_fail (QMI_IS_DEVICE (self), FALSE);
+
+    g_mutex_lock (&self->priv->mutex);
+    backpressure = self->priv->backpressure;
+    g_mutex_unlock (&self->priv->mutex);
+
+    return backpressure;
+}
+
+/*****************************************************************************/
+/* Register/Unregister clients that want to receive indications */
+
+static gpointer
+build_registered_client_key (guint8 cid,
+                             QmiService service)
+{
+    return GUINT_TO_POINTER (((guint8)service << 8) | cid);
+}
+
+static gboolean
+register_client (QmiDevice *self,
+                 QmiClient *client,
+                 GError **error)
+{
+    gpointer key;
+    GPtrArray *clients;
+
+    key = build_registered_client_key (qmi_client_get_cid (client),
+                                       qmi_client_get_service (client));
+
+    g_mutex_lock (&self->priv->mutex);
 
-    key = build_registered_client_key (qmi_client_get_cid (client),
-                                       qmi_client_get_service (client));
     /* Only add the new client if not already registered one with the same CID
      * for the same service */
     if (g_hash_table_lookup (self->priv->registered_clients, key)) {
+        g_mutex_unlock (&self->priv->mutex);
         g_set_error (error,
                      QMI_CORE_ERROR,
                      QMI_CORE_ERROR_FAILED,
@@ -368,16 +1217,49 @@ register_client (QmiDevice *self,
     g_hash_table_insert (self->priv->registered_clients,
                          key,
                          g_object_ref (client));
+
+    clients = g_hash_table_lookup (self->priv->service_clients,
+                                   GUINT_TO_POINTER (qmi_client_get_service (client)));
+    if (!clients) {
+        clients = g_ptr_array_new ();
+        g_hash_table_insert (self->priv->service_clients,
+                             GUINT_TO_POINTER (qmi_client_get_service (client)),
+                             clients);
+    }
+    g_ptr_array_add (clients, client);
+
+    g_mutex_unlock (&self->priv->mutex);
     return TRUE;
 }
 
+/* Must be called with the device mutex held */
+static void
+unregister_client_unlocked (QmiDevice *self,
+                            QmiClient *client)
+{
+    gpointer key;
+    GPtrArray *clients;
+
+    key = build_registered_client_key (qmi_client_get_cid (client),
+                                       qmi_client_get_service (client));
+
+    /* Only drop it from the per-service list if it was the one registered */
+    if (g_hash_table_lookup (self->priv->registered_clients, key) == client) {
+        clients = g_hash_table_lookup (self->priv->service_clients,
+                                       GUINT_TO_POINTER (qmi_client_get_service (client)));
+        if (clients)
+            g_ptr_array_remove_fast (clients, client);
+        g_hash_table_remove (self->priv->registered_clients, key);
+    }
+}
+
 static void
 unregister_client (QmiDevice *self,
                    QmiClient *client)
 {
-    g_hash_table_remove (self->priv->registered_clients,
-                         build_registered_client_key (qmi_client_get_cid (client),
-                                                      qmi_client_get_service (client)));
+    g_mutex_lock (&self->priv->mutex);
+    unregister_client_unlocked (self, client);
+    g_mutex_unlock (&self->priv->mutex);
 }
 
 /*****************************************************************************/
@@ -756,39 +1638,77 @@ qmi_device_release_client (QmiDevice *self,
 typedef struct {
     QmiClient *client;
     QmiMessage *message;
-} IdleIndicationContext;
+} PendingIndication;
 
-static gboolean
-process_indication_idle (IdleIndicationContext *ctx)
+static void
+pending_indication_free (PendingIndication *pending)
 {
-    g_assert (ctx->client != NULL);
-    g_assert (ctx->message != NULL);
+    g_object_unref (pending->client);
+    qmi_message_unref (pending->message);
+    g_slice_free (PendingIndication, pending);
+}
 
-    qmi_client_process_indication (ctx->client, ctx->message);
+static gboolean
+process_indications_idle (QmiDevice *self)
+{
+    GQueue queue = G_QUEUE_INIT;
+    PendingIndication *pending;
+
+    /* Take the whole batch; indications received while the clients process
+     * these ones will schedule a new idle */
+    g_mutex_lock (&self->priv->mutex);
+    queue = self->priv->indication_queue;
+    g_queue_init (&self->priv->indication_queue);
+    self->priv->indication_idle_pending = FALSE;
+    g_mutex_unlock (&self->priv->mutex);
+
+    while ((pending = g_queue_pop_head (&queue)) != NULL) {
+        qmi_client_process_indication (pending->client, pending->message);
+        pending_indication_free (pending);
+    }
 
-    g_object_unref (ctx->client);
-    qmi_message_unref (ctx->message);
-    g_slice_free (IdleIndicationContext, ctx);
+    g_object_unref (self);
     return FALSE;
 }
 
+/* Must be called with the device mutex held */
 static void
-report_indication (QmiClient *client,
+report_indication (QmiDevice *self,
+                   QmiClient *client,
                    QmiMessage *message)
 {
-    IdleIndicationContext *ctx;
-
-    /* Setup an idle to Pass the indication down to the client */
-    ctx = g_slice_new (IdleIndicationContext);
-    ctx->client = g_object_ref (client);
-    ctx->message = qmi_message_ref (message);
-    g_idle_add ((GSourceFunc)process_indication_idle, ctx);
+    PendingIndication *pending;
+
+    /* Indications are processed in the owner context, possibly in another
+     * thread; give them their own frame before they leave the I/O thread */
+    qmi_message_detach_borrowed (message);
+
+    pending = g_slice_new (PendingIndication);
+    pending->client = g_object_ref (client);
+    pending->message = qmi_message_ref (message);
+    g_queue_push_tail (&self->priv->indication_queue, pending);
+
+    /* Setup an idle to pass the queued indications down to the clients, in
+     * the context the device was opened from */
+    if (!self->priv->indication_idle_pending) {
+        GSource *source;
+
+        source = g_idle_source_new ();
+        g_source_set_callback (source,
+                               (GSourceFunc)process_indications_idle,
+                               g_object_ref (self),
+                               NULL);
+        g_source_attach (source, self->priv->owner_context);
+        g_source_unref (source);
+        self->priv->indication_idle_pending = TRUE;
+    }
 }
 
 static void
 process_message (QmiDevice *self,
                  QmiMessage *message)
 {
+    const QmiMessageHeader *header;
     GError *error = NULL;
 
     /* Ensure the read message is valid */
@@ -796,6 +1716,8 @@ process_message (QmiDevice *self,
         g_warning ("Invalid QMI message received: %s",
                    error->message);
         g_error_free (error);
+        self->priv->rx_bytes_dropped += qmi_message_get_length (message);
+        self->priv->rx_frames_dropped++;
         return;
     }
 
@@ -811,41 +1733,42 @@ process_message (QmiDevice *self,
     }
 #endif /* MESSAGE_ENABLE_TRACE */
 
-    if (qmi_message_is_indication (message)) {
-        if (qmi_message_get_client_id (message) == QMI_CID_BROADCAST) {
-            GHashTableIter iter;
-            gpointer key;
-            QmiClient *client;
+    header = QMI_MESSAGE_HEADER (message);
 
-            g_hash_table_iter_init (&iter, self->priv->registered_clients);
-            while (g_hash_table_iter_next (&iter, &key, (gpointer *)&client)) {
-                /* For broadcast messages, report them just if the service matches */
-                if (qmi_message_get_service (message) == qmi_client_get_service (client))
-                    report_indication (client, message);
-            }
+    if (header->is_indication) {
+        if (header->client_id == QMI_CID_BROADCAST) {
+            GPtrArray *clients;
+            guint i;
+
+            /* For broadcast messages, report them to all clients of the service */
+            clients = g_hash_table_lookup (self->priv->service_clients,
+                                          GUINT_TO_POINTER ((guint)header->service));
+            for (i = 0; clients && i < clients->len; i++)
+                report_indication (self,
+                                   QMI_CLIENT (g_ptr_array_index (clients, i)),
+                                   message);
         } else {
             QmiClient *client;
 
             client = g_hash_table_lookup (self->priv->registered_clients,
-                                          build_registered_client_key (qmi_message_get_client_id (message),
-                                                                       qmi_message_get_service (message)));
+                                          build_registered_client_key (header->client_id,
+                                                                       header->service));
             if (client)
-                report_indication (client, message);
+                report_indication (self, client, message);
         }
 
         return;
     }
 
-    if (qmi_message_is_response (message)) {
-        Transaction *tr;
+    if (header->is_response) {
+        Transaction tr;
 
-        tr = device_match_transaction (self, message);
-        if (!tr)
+        if (!device_match_transaction (self, message, &tr))
             g_debug ("[%s] No transaction matched in received message",
                      self->priv->path_display);
         else
             /* Report the reply message */
-            transaction_complete_and_free (tr, message, NULL);
+            transaction_complete (&tr, message, NULL);
 
         return;
     }
@@ -854,116 +1777,294 @@ process_message (QmiDevice *self,
              self->priv->path_display);
 }
 
+/* Drops bytes from the head of the receive buffer up to the next position
+ * which looks like the start of a frame, or up to the end of the buffer if
+ * there is none */
+static void
+rx_buffer_resync (QmiDevice *self)
+{
+    const guint8 *start;
+    const guint8 *end;
+    const guint8 *p;
+    gsize dropped;
+
+    start = &self->priv->rx_buffer[self->priv->rx_start];
+    end = &self->priv->rx_buffer[self->priv->rx_end];
+
+    for (p = start + 1; p < end; p++) {
+        p = memchr (p, QMI_MESSAGE_QMUX_MARKER, end - p);
+        if (!p) {
+            p = end;
+            break;
+        }
+        if (qmi_message_raw_is_plausible (p, end - p))
+            break;
+    }
+
+    dropped = p - start;
+    self->priv->rx_start += dropped;
+    self->priv->rx_bytes_dropped += dropped;
+    self->priv->rx_frames_dropped++;
+
+    g_warning ("[%s] QMI framing error detected: dropped %" G_GSIZE_FORMAT " bytes",
+               self->priv->path_display,
+               dropped);
+}
+
 static void
 parse_response (QmiDevice *self)
 {
-    do {
+    /* The buffer offsets are re-read on every iteration, as processing a
+     * message may end up closing the device, which empties the buffer */
+    while (self->priv->rx_start < self->priv->rx_end) {
         QmiMessage *message;
 
-        /* Every message received must start with the QMUX marker.
-         * If it doesn't, we broke framing :-/
-         * If we broke framing, an error should be reported and the device
-         * should get closed */
-        if (self->priv->response->len > 0 &&
-            self->priv->response->data[0] != QMI_MESSAGE_QMUX_MARKER) {
-            /* TODO: Report fatal error */
-            g_warning ("QMI framing error detected");
-            return;
+        /* Every message received must start with the QMUX marker and a
+         * sane header. If it doesn't, we broke framing :-/ so skip the
+         * garbage up to the next frame */
+        if (!qmi_message_raw_is_plausible (&self->priv->rx_buffer[self->priv->rx_start],
+                                           self->priv->rx_end - self->priv->rx_start)) {
+            rx_buffer_resync (self);
+            continue;
         }
 
-        message = qmi_message_new_from_raw (self->priv->response->data,
-                                            self->priv->response->len);
+        /* The message is parsed in place; its frame gets copied out of the
+         * receive buffer only if someone keeps a reference to it */
+        message = qmi_message_new_from_raw_borrowed (self->priv->message_pool,
+                                                     &self->priv->rx_buffer[self->priv->rx_start],
+                                                     self->priv->rx_end - self->priv->rx_start);
         if (!message)
             /* More data we need */
-            return;
+            break;
 
-        /* Remove the read data from the response buffer */
-        g_byte_array_remove_range (self->priv->response,
-                                   0,
-                                   qmi_message_get_length (message));
+        self->priv->rx_start += qmi_message_get_length (message);
+        self->priv->frames_received++;
 
         /* Play with the received message */
         process_message (self, message);
 
-        qmi_message_unref (message);
-    } while (self->priv->response->len > 0);
+        qmi_message_release_borrowed (message);
+    }
+
+    /* Everything consumed, start over from the beginning of the buffer */
+    if (self->priv->rx_start == self->priv->rx_end)
+        self->priv->rx_start = self->priv->rx_end = 0;
 }
 
-static gboolean
-data_available (GIOChannel *source,
-                GIOCondition condition,
-                QmiDevice *self)
+static void
+rx_buffer_reset (QmiDevice *self)
 {
-    gsize bytes_read;
-    GIOStatus status;
-    gchar buffer[BUFFER_SIZE + 1];
+    self->priv->rx_start = 0;
+    self->priv->rx_end = 0;
+}
 
-    if (condition & G_IO_HUP) {
-        g_debug ("[%s] unexpected port hangup!",
-                 self->priv->path_display);
+static void device_hangup    (QmiDevice *self);
+static void reconnect_cancel (QmiDevice *self);
 
-        if (self->priv->response &&
-            self->priv->response->len)
-            g_byte_array_remove_range (self->priv->response, 0, self->priv->response->len);
+/* Reads until the device has nothing else to give, parsing frames as they
+ * get in. Must be called without the device mutex held, as a hangup closes
+ * the device. */
+static void
+data_available (QmiDevice *self,
+                GIOCondition condition)
+{
+    gboolean hangup = FALSE;
+    GPtrArray *completed = NULL;
+    guint i;
 
-        qmi_device_close (self, NULL);
-        return FALSE;
-    }
+    g_mutex_lock (&self->priv->mutex);
 
-    if (condition & G_IO_ERR) {
-        if (self->priv->response &&
-            self->priv->response->len)
-            g_byte_array_remove_range (self->priv->response, 0, self->priv->response->len);
-        return TRUE;
+    if (self->priv->direct_completion) {
+        if (G_UNLIKELY (!self->priv->completed_results))
+            self->priv->completed_results = g_ptr_array_new ();
+        self->priv->collect_results = TRUE;
     }
 
-    /* If not ready yet, prepare the response with default initial size. */
-    if (G_UNLIKELY (!self->priv->response))
-        self->priv->response = g_byte_array_sized_new (500);
+    /* If not ready yet, allocate the receive buffer. Frames are read into
+     * its free space and parsed in place; only a partial frame left at the
+     * very end of the buffer is ever moved. */
+    if (G_UNLIKELY (!self->priv->rx_buffer))
+        self->priv->rx_buffer = g_malloc (RX_BUFFER_SIZE);
+
+    /* Even on hangup or error, get whatever is still there; read() tells
+     * what happened once it's all consumed */
+    while (self->priv->fd >= 0) {
+        gssize n_read;
+
+        /* No room left after a partial frame; move it to the beginning */
+        if (self->priv->rx_end == RX_BUFFER_SIZE) {
+            if (self->priv->rx_start == 0) {
+                /* Can only happen if framing is broken */
+                g_warning ("QMI receive buffer full, discarding its contents");
+                rx_buffer_reset (self);
+            } else {
+                memmove (self->priv->rx_buffer,
+                         &self->priv->rx_buffer[self->priv->rx_start],
+                         self->priv->rx_end - self->priv->rx_start);
+                self->priv->rx_end -= self->priv->rx_start;
+                self->priv->rx_start = 0;
+            }
+        }
 
-    do {
-        GError *error = NULL;
-
-        status = g_io_channel_read_chars (source,
-                                          buffer,
-                                          BUFFER_SIZE,
-                                          &bytes_read,
-                                          &error);
-        if (status == G_IO_STATUS_ERROR) {
-            if (error) {
-                g_warning ("error reading from the IOChannel: '%s'", error->message);
-                g_error_free (error);
+        n_read = read (self->priv->fd,
+                       &self->priv->rx_buffer[self->priv->rx_end],
+                       RX_BUFFER_SIZE - self->priv->rx_end);
+        self->priv->read_syscalls++;
+
+        if (n_read > 0) {
+            self->priv->rx_end += n_read;
+
+            /* Try to parse what we already got */
+            parse_response (self);
+            continue;
+        }
+
+        if (n_read == 0) {
+            g_debug ("[%s] unexpected port hangup!",
+                     self->priv->path_display);
+            hangup = TRUE;
+        } else if (errno == EINTR)
+            continue;
+        else if (errno == EAGAIN) {
+            /* All read; an error without an errno is still fatal */
+            if (condition & (G_IO_HUP | G_IO_ERR)) {
+                g_debug ("[%s] port %s with no more data to read",
+                         self->priv->path_display,
+                         (condition & G_IO_HUP) ? "hangup" : "error");
+                hangup = TRUE;
             }
+        } else {
+            g_warning ("[%s] error reading from the device: '%s'",
+                       self->priv->path_display,
+                       strerror (errno));
+            hangup = TRUE;
+        }
+        break;
+    }
 
-            /* Port is closed; we're done */
-            if (self->priv->watch_id == 0)
-                break;
+    /* Responses may have made room in the in-flight window */
+    if (!hangup)
+        pending_queue_pump (self);
+
+    /* Take the collected results, in case a callback ends up reading from
+     * the device again, e.g. after reopening it */
+    if (self->priv->collect_results) {
+        self->priv->collect_results = FALSE;
+        completed = self->priv->completed_results;
+        self->priv->completed_results = NULL;
+    }
+    g_mutex_unlock (&self->priv->mutex);
+
+    /* Direct completion, once the device can take new requests. The user
+     * callbacks may drop the last reference to the device, so keep one
+     * until we're done. */
+    g_object_ref (self);
+    if (completed) {
+        for (i = 0; i < completed->len; i++) {
+            g_simple_async_result_complete (g_ptr_array_index (completed, i));
+            g_object_unref (g_ptr_array_index (completed, i));
         }
 
-        /* If no bytes read, just let g_io_channel wait for more data */
-        if (bytes_read == 0)
-            break;
+        /* Keep the array for the next time */
+        g_ptr_array_set_size (completed, 0);
+        g_mutex_lock (&self->priv->mutex);
+        if (!self->priv->completed_results) {
+            self->priv->completed_results = completed;
+            completed = NULL;
+        }
+        g_mutex_unlock (&self->priv->mutex);
+        if (completed)
+            g_ptr_array_unref (completed);
+    }
 
-        if (bytes_read > 0)
-            g_byte_array_append (self->priv->response, (const guint8 *)buffer, bytes_read);
+    if (hangup)
+        device_hangup (self);
+    g_object_unref (self);
+}
 
-        /* Try to parse what we already got */
-        parse_response (self);
+/* Source polling the device file descriptor. It always waits for input,
+ * and for room to write only while the write queue is blocked. */
 
-        /* And keep on if we were told to keep on */
-    } while (bytes_read == BUFFER_SIZE || status == G_IO_STATUS_AGAIN);
+typedef struct {
+    GSource source;
+    GPollFD pollfd;
+    QmiDevice *self;
+} FdSource;
+
+static void write_ready (QmiDevice *self);
 
+static gboolean
+fd_source_prepare (GSource *source,
+                   gint *timeout)
+{
+    *timeout = -1;
+    return FALSE;
+}
+
+static gboolean
+fd_source_check (GSource *source)
+{
+    FdSource *fd_source = (FdSource *)source;
+
+    return !!(fd_source->pollfd.revents & (fd_source->pollfd.events | G_IO_HUP | G_IO_ERR | G_IO_NVAL));
+}
+
+static gboolean
+fd_source_dispatch (GSource *source,
+                    GSourceFunc callback,
+                    gpointer user_data)
+{
+    FdSource *fd_source = (FdSource *)source;
+    GIOCondition revents;
+
+    revents = fd_source->pollfd.revents;
+
+    if (revents & G_IO_OUT)
+        write_ready (fd_source->self);
+
+    if (revents & (G_IO_IN | G_IO_HUP | G_IO_ERR | G_IO_NVAL))
+        data_available (fd_source->self, revents);
+
+    /* Removed when the device gets closed */
     return TRUE;
 }
 
+static GSourceFuncs fd_source_funcs = {
+    fd_source_prepare,
+    fd_source_check,
+    fd_source_dispatch,
+    NULL
+};
+
+/* Must be called with the device mutex held */
+static void
+fd_source_update_events (QmiDevice *self)
+{
+    FdSource *fd_source = (FdSource *)self->priv->fd_source;
+    gushort events;
+
+    if (!fd_source)
+        return;
+
+    events = G_IO_IN | G_IO_HUP | G_IO_ERR;
+    if (self->priv->tx_blocked)
+        events |= G_IO_OUT;
+
+    if (fd_source->pollfd.events != events) {
+        fd_source->pollfd.events = events;
+        /* The loop may already be polling with the old events */
+        g_main_context_wakeup (g_source_get_context (self->priv->fd_source));
+    }
+}
+
 static gboolean
-create_iochannel (QmiDevice *self,
-                  GError **error)
+open_fd (QmiDevice *self,
+         GError **error)
 {
-    GError *inner_error = NULL;
-    guint fd;
+    FdSource *fd_source;
+    gint fd;
 
-    if (self->priv->iochannel) {
+    if (self->priv->fd >= 0) {
         g_set_error (error,
                      QMI_CORE_ERROR,
                      QMI_CORE_ERROR_WRONG_STATE,
@@ -974,6 +2075,7 @@ create_iochannel (QmiDevice *self,
     g_assert (self->priv->file);
     g_assert (self->priv->path);
 
+    /* Non-blocking, so that we never get stuck reading or writing */
     errno = 0;
     fd = open (self->priv->path, O_RDWR | O_EXCL | O_NONBLOCK | O_NOCTTY);
     if (fd < 0) {
@@ -986,243 +2088,998 @@ create_iochannel (QmiDevice *self,
         return FALSE;
     }
 
-    /* Create new GIOChannel */
-    self->priv->iochannel = g_io_channel_unix_new (fd);
+    g_mutex_lock (&self->priv->mutex);
+
+    self->priv->fd = fd;
+
+    fd_source = (FdSource *)g_source_new (&fd_source_funcs, sizeof (FdSource));
+    fd_source->self = self;
+    fd_source->pollfd.fd = fd;
+    fd_source->pollfd.events = G_IO_IN | G_IO_HUP | G_IO_ERR;
+    g_source_add_poll ((GSource *)fd_source, &fd_source->pollfd);
+    g_source_attach ((GSource *)fd_source, self->priv->io_context);
+    self->priv->fd_source = (GSource *)fd_source;
+
+    g_mutex_unlock (&self->priv->mutex);
+
+    return TRUE;
+}
+
+typedef struct {
+    QmiDevice *self;
+    GSimpleAsyncResult *result;
+    GCancellable *cancellable;
+    QmiDeviceOpenFlags flags;
+    guint timeout_ms;
+} DeviceOpenContext;
+
+static void
+device_open_context_complete_and_free (DeviceOpenContext *ctx)
+{
+    g_simple_async_result_complete_in_idle (ctx->result);
+    g_object_unref (ctx->result);
+    if (ctx->cancellable)
+        g_object_unref (ctx->cancellable);
+    g_object_unref (ctx->self);
+    g_slice_free (DeviceOpenContext, ctx);
+}
+
+/**
+ * qmi_device_open_finish:
+ * @self: a #QmiDevice.
+ * @res: a #GAsyncResult.
+ * @error: a #GError.
+ *
+ * Finishes an asynchronous open operation started with qmi_device_open_async().
+ *
+ * Returns: #TRUE if successful, #FALSE if @error is set.
+ */
+gboolean
+qmi_device_open_finish (QmiDevice *self,
+                        GAsyncResult *res,
+                        GError **error)
+{
+    return !g_simple_async_result_propagate_error (G_SIMPLE_ASYNC_RESULT (res), error);
+}
+
+static void process_open_flags (DeviceOpenContext *ctx);
+
+static void
+sync_ready (QmiClientCtl *client_ctl,
+            GAsyncResult *res,
+            DeviceOpenContext *ctx)
+{
+    GError *error = NULL;
+
+    if (!qmi_client_ctl_sync_finish (client_ctl, res, &error)) {
+        g_prefix_error (&error, "Sync failed: ");
+        g_simple_async_result_take_error (ctx->result, error);
+        device_open_context_complete_and_free (ctx);
+        return;
+    }
+
+    g_debug ("[%s] Sync operation finished",
+             ctx->self->priv->path_display);
+
+    /* Keep on with next flags */
+    process_open_flags (ctx);
+}
 
-    /* We don't want UTF-8 encoding, we're playing with raw binary data */
-    g_io_channel_set_encoding (self->priv->iochannel, NULL, NULL);
+static void
+version_info_ready (QmiClientCtl *client_ctl,
+                    GAsyncResult *res,
+                    DeviceOpenContext *ctx)
+{
+    GError *error = NULL;
+    guint i;
+
+    ctx->self->priv->supported_services = qmi_client_ctl_get_version_info_finish (client_ctl, res, &error);
+    if (!ctx->self->priv->supported_services) {
+        g_prefix_error (&error, "Version info check failed: ");
+        g_simple_async_result_take_error (ctx->result, error);
+        device_open_context_complete_and_free (ctx);
+        return;
+    }
+
+    g_debug ("[%s] QMI Device supports %u services:",
+             ctx->self->priv->path_display,
+             ctx->self->priv->supported_services->len);
+    for (i = 0; i < ctx->self->priv->supported_services->len; i++) {
+        QmiCtlVersionInfo *service;
+
+        service = g_ptr_array_index (ctx->self->priv->supported_services, i);
+        g_debug ("[%s]    %s (%u.%u)",
+                 ctx->self->priv->path_display,
+                 qmi_service_get_string (qmi_ctl_version_info_get_service (service)),
+                 qmi_ctl_version_info_get_major_version (service),
+                 qmi_ctl_version_info_get_minor_version (service));
+    }
+
+    /* Keep on with next flags */
+    process_open_flags (ctx);
+}
+
+static void
+process_open_flags (DeviceOpenContext *ctx)
+{
+    /* Query version info? */
+    if (ctx->flags & QMI_DEVICE_OPEN_FLAGS_VERSION_INFO) {
+        g_debug ("Checking version info...");
+        ctx->flags &= ~QMI_DEVICE_OPEN_FLAGS_VERSION_INFO;
+        qmi_client_ctl_get_version_info_ms (ctx->self->priv->client_ctl,
+                                            ctx->timeout_ms,
+                                            ctx->cancellable,
+                                            (GAsyncReadyCallback)version_info_ready,
+                                            ctx);
+        return;
+    }
+
+    /* Sync? */
+    if (ctx->flags & QMI_DEVICE_OPEN_FLAGS_SYNC) {
+        g_debug ("Running sync...");
+        ctx->flags &= ~QMI_DEVICE_OPEN_FLAGS_SYNC;
+        qmi_client_ctl_sync_ms (ctx->self->priv->client_ctl,
+                                ctx->timeout_ms,
+                                ctx->cancellable,
+                                (GAsyncReadyCallback)sync_ready,
+                                ctx);
+        return;
+    }
+
+    /* No more flags to process, done we are */
+    g_simple_async_result_set_op_res_gboolean (ctx->result, TRUE);
+    device_open_context_complete_and_free (ctx);
+}
+
+/**
+ * qmi_device_open:
+ * @self: a #QmiDevice.
+ * @flags: mask of #QmiDeviceOpenFlags specifying how the device should be opened.
+ * @timeout: maximum time, in seconds, to wait for the device to be opened.
+ * @cancellable: optional #GCancellable object, #NULL to ignore.
+ * @callback: a #GAsyncReadyCallback to call when the operation is finished.
+ * @user_data: the data to pass to callback function.
+ *
+ * Asynchronously opens a #QmiDevice for I/O.
+ *
+ * When the operation is finished @callback will be called. You can then call
+ * qmi_device_open_finish() to get the result of the operation.
+ */
+void
+qmi_device_open (QmiDevice *self,
+                 QmiDeviceOpenFlags flags,
+                 guint timeout,
+                 GCancellable *cancellable,
+                 GAsyncReadyCallback callback,
+                 gpointer user_data)
+{
+    qmi_device_open_ms (self,
+                        flags,
+                        qmi_utils_timeout_to_ms (timeout),
+                        cancellable,
+                        callback,
+                        user_data);
+}
+
+/**
+ * qmi_device_open_ms:
+ * @self: a #QmiDevice.
+ * @flags: mask of #QmiDeviceOpenFlags specifying how the device should be opened.
+ * @timeout_ms: maximum time, in milliseconds, to wait for each of the requests
+ * sent while opening the device.
+ * @cancellable: optional #GCancellable object, #NULL to ignore.
+ * @callback: a #GAsyncReadyCallback to call when the operation is finished.
+ * @user_data: the data to pass to callback function.
+ *
+ * Like qmi_device_open(), but with the timeout given in milliseconds.
+ */
+void
+qmi_device_open_ms (QmiDevice *self,
+                    QmiDeviceOpenFlags flags,
+                    guint timeout_ms,
+                    GCancellable *cancellable,
+                    GAsyncReadyCallback callback,
+                    gpointer user_data)
+{
+    DeviceOpenContext *ctx;
+    GError *error = NULL;
+
+    g_return_if_fail (QMI_IS_DEVICE (self));
+
+    ctx = g_slice_new (DeviceOpenContext);
+    ctx->self = g_object_ref (self);
+    ctx->result = g_simple_async_result_new (G_OBJECT (self),
+                                             callback,
+                                             user_data,
+                                             qmi_device_open);
+    ctx->flags = flags;
+    ctx->timeout_ms = timeout_ms;
+    ctx->cancellable = (cancellable ? g_object_ref (cancellable) : NULL);
+
+    /* The pool is kept until the device is disposed, so that its stats
+     * survive re-opening the device */
+    if ((flags & QMI_DEVICE_OPEN_FLAGS_MESSAGE_POOL) &&
+        !self->priv->message_pool)
+        self->priv->message_pool = qmi_message_pool_new (MESSAGE_POOL_BLOCK_SIZE,
+                                                         MESSAGE_POOL_MAX_FREE);
+
+    /* Likewise, once started the I/O thread runs until the device is
+     * disposed */
+    if ((flags & QMI_DEVICE_OPEN_FLAGS_IO_THREAD) &&
+        !self->priv->io_thread)
+        io_thread_start (self);
+
+    if (self->priv->owner_context)
+        g_main_context_unref (self->priv->owner_context);
+    self->priv->owner_context = g_main_context_ref_thread_default ();
+
+    /* Reopening by hand supersedes any pending reconnection */
+    reconnect_cancel (self);
+    self->priv->auto_reconnect = !!(flags & QMI_DEVICE_OPEN_FLAGS_AUTO_RECONNECT);
+
+    /* Results can only be completed while reading if reads are dispatched
+     * in the same context the requests are issued from */
+    self->priv->direct_completion = ((flags & QMI_DEVICE_OPEN_FLAGS_DIRECT_COMPLETION) &&
+                                     !self->priv->io_thread &&
+                                     self->priv->owner_context == g_main_context_default ());
+
+    if (!open_fd (self, &error)) {
+        g_prefix_error (&error,
+                        "Cannot open QMI device: ");
+        g_simple_async_result_take_error (ctx->result, error);
+        device_open_context_complete_and_free (ctx);
+        return;
+    }
+
+    /* Process all open flags */
+    process_open_flags (ctx);
+}
+
+/*****************************************************************************/
+/* Write queue */
+
+/* A queued frame; the raw data is taken once, when the message is checked
+ * before sending, and it stays valid as long as the message is referenced */
+typedef struct {
+    QmiMessage *message;
+    gconstpointer raw;
+    gsize raw_len;
+} TxFrame;
+
+#define TX_FRAME_AT(self, i) (&g_array_index ((self)->priv->tx_frames, TxFrame, (self)->priv->tx_head + (i)))
+
+/* Drops the frame at the head of the queue. Frames are kept in a plain array
+ * which is only compacted once at least half of it was consumed, so queuing
+ * and dropping frames doesn't allocate in the long run. */
+static void
+write_queue_pop_head (QmiDevice *self)
+{
+    qmi_message_unref (TX_FRAME_AT (self, 0)->message);
+    self->priv->tx_head++;
+
+    if (self->priv->tx_head == self->priv->tx_frames->len) {
+        g_array_set_size (self->priv->tx_frames, 0);
+        self->priv->tx_head = 0;
+    } else if (self->priv->tx_head >= TX_MAX_IOV &&
+               self->priv->tx_head * 2 >= self->priv->tx_frames->len) {
+        g_array_remove_range (self->priv->tx_frames, 0, self->priv->tx_head);
+        self->priv->tx_head = 0;
+    }
+}
+
+static void
+write_queue_clear (QmiDevice *self)
+{
+    self->priv->tx_blocked = FALSE;
+    self->priv->tx_broken = FALSE;
+    fd_source_update_events (self);
+
+    while (TX_QUEUE_LENGTH (self) > 0)
+        write_queue_pop_head (self);
+    self->priv->tx_offset = 0;
+    self->priv->tx_bytes_pending = 0;
+}
+
+static gboolean
+write_failed_hangup_idle (QmiDevice *self)
+{
+    gboolean hangup;
+
+    /* Unless the device was closed meanwhile */
+    g_mutex_lock (&self->priv->mutex);
+    hangup = (self->priv->fd >= 0 && self->priv->tx_broken);
+    g_mutex_unlock (&self->priv->mutex);
+
+    if (hangup)
+        device_hangup (self);
+    return FALSE;
+}
+
+static void
+write_queue_fail (QmiDevice *self,
+                  const GError *error)
+{
+    GSource *source;
+
+    /* Framing towards the device is broken once a write fails, so drop
+     * everything queued and report the error to all of them */
+    while (TX_QUEUE_LENGTH (self) > 0) {
+        Transaction tr;
+
+        /* Match transaction so that we remove it from our tracking table */
+        if (device_match_transaction (self, TX_FRAME_AT (self, 0)->message, &tr))
+            transaction_complete (&tr, NULL, error);
+        write_queue_pop_head (self);
+    }
+    self->priv->tx_offset = 0;
+    self->priv->tx_bytes_pending = 0;
+
+    /* Nothing else can be written after a partial frame, so handle it like
+     * a read error and hang up the device. The mutex is held here, so do it
+     * from an idle; until then, the queue is no longer flushed. */
+    if (!self->priv->tx_broken) {
+        self->priv->tx_broken = TRUE;
+        source = g_idle_source_new ();
+        g_source_set_callback (source,
+                               (GSourceFunc)write_failed_hangup_idle,
+                               g_object_ref (self),
+                               g_object_unref);
+        device_attach_source (self, source);
+    }
+}
+
+/* Writes as much of the queue as possible with a single writev(). Returns
+ * TRUE if there is still data pending, in which case the device source also
+ * waits for G_IO_OUT to keep on writing. */
+static gboolean
+write_queue_flush (QmiDevice *self)
+{
+    struct iovec iov[TX_MAX_IOV];
+    guint n_iov;
+    gssize written;
+
+    if (self->priv->tx_broken || TX_QUEUE_LENGTH (self) == 0)
+        return FALSE;
+
+    for (n_iov = 0; n_iov < MIN (TX_QUEUE_LENGTH (self), TX_MAX_IOV); n_iov++) {
+        iov[n_iov].iov_base = (gpointer)TX_FRAME_AT (self, n_iov)->raw;
+        iov[n_iov].iov_len = TX_FRAME_AT (self, n_iov)->raw_len;
+    }
+
+    /* Skip the part of the head message already written */
+    iov[0].iov_base = (guint8 *)iov[0].iov_base + self->priv->tx_offset;
+    iov[0].iov_len -= self->priv->tx_offset;
+
+    do {
+        written = writev (self->priv->fd, iov, n_iov);
+        self->priv->write_syscalls++;
+    } while (written < 0 && errno == EINTR);
+
+    if (written < 0 && errno != EAGAIN) {
+        GError *error;
+
+        error = g_error_new (QMI_CORE_ERROR,
+                             QMI_CORE_ERROR_FAILED,
+                             "Cannot write message: %s",
+                             strerror (errno));
+        write_queue_fail (self, error);
+        g_error_free (error);
+        return FALSE;
+    }
+
+    if (written > 0) {
+        self->priv->tx_bytes_pending -= written;
+
+        /* Release the messages fully written */
+        written += self->priv->tx_offset;
+        while (written > 0) {
+            gsize len;
+
+            len = TX_FRAME_AT (self, 0)->raw_len;
+            if ((gsize)written < len)
+                break;
+
+            written -= len;
+            write_queue_pop_head (self);
+        }
+        self->priv->tx_offset = written;
+    }
+
+    if (TX_QUEUE_LENGTH (self) == 0)
+        return FALSE;
+
+    /* Wait until the device can take more */
+    if (!self->priv->tx_blocked) {
+        self->priv->tx_blocked = TRUE;
+        fd_source_update_events (self);
+    }
+    return TRUE;
+}
+
+static void
+write_ready (QmiDevice *self)
+{
+    g_mutex_lock (&self->priv->mutex);
+    if (self->priv->fd >= 0 && !write_queue_flush (self)) {
+        self->priv->tx_blocked = FALSE;
+        fd_source_update_events (self);
+    }
+    g_mutex_unlock (&self->priv->mutex);
+}
+
+/* Queues the message of a transaction for writing, accounting it in the
+ * in-flight window */
+static void
+transaction_queue_write (QmiDevice *self,
+                         Transaction *tr)
+{
+    TxFrame frame;
+
+    in_flight_add (self, tr);
+
+    frame.message = qmi_message_ref (tr->message);
+    frame.raw = tr->raw;
+    frame.raw_len = tr->raw_len;
+    g_array_append_val (self->priv->tx_frames, frame);
+    self->priv->tx_bytes_pending += frame.raw_len;
+}
+
+/* Sends as many of the pending transactions as the in-flight window allows.
+ * Transactions of a client or service with a full window are skipped, so
+ * they don't hold back the others. */
+static void
+pending_queue_pump (QmiDevice *self)
+{
+    GList *l;
+    GList *next;
+    gboolean queued = FALSE;
+
+    if (self->priv->fd < 0)
+        return;
+
+    for (l = self->priv->pending_queue.head; l; l = next) {
+        Transaction *tr = l->data;
+
+        next = g_list_next (l);
+        if (!in_flight_window_allows (self, tr))
+            continue;
+
+        g_queue_delete_link (&self->priv->pending_queue, l);
+        tr->pending_link = NULL;
+        transaction_queue_write (self, tr);
+        queued = TRUE;
+    }
+
+    if (queued && !self->priv->tx_blocked)
+        write_queue_flush (self);
+
+    backpressure_update (self);
+}
+
+/*****************************************************************************/
+/* Close device file */
+
+static gboolean
+close_fd (QmiDevice *self,
+          GError **error)
+{
+    GError *inner_error = NULL;
+    GError *closed_error;
+
+    g_mutex_lock (&self->priv->mutex);
+
+    /* Already closed? */
+    if (self->priv->fd < 0) {
+        g_mutex_unlock (&self->priv->mutex);
+        return TRUE;
+    }
+
+    /* Whatever wasn't written yet is lost, and no response will ever come
+     * for the transactions still ongoing, so fail them all right away */
+    write_queue_clear (self);
+    closed_error = g_error_new (QMI_CORE_ERROR,
+                                QMI_CORE_ERROR_WRONG_STATE,
+                                "Device was closed");
+    transactions_fail_all (self, closed_error);
+    g_error_free (closed_error);
+
+    g_source_destroy (self->priv->fd_source);
+    g_source_unref (self->priv->fd_source);
+    self->priv->fd_source = NULL;
+
+    /* Failures when closing still make the device to get closed */
+    if (close (self->priv->fd) < 0)
+        inner_error = g_error_new (QMI_CORE_ERROR,
+                                   QMI_CORE_ERROR_FAILED,
+                                   "Cannot close device file '%s': %s",
+                                   self->priv->path_display,
+                                   strerror (errno));
+    self->priv->fd = -1;
+
+    /* The buffer itself is kept until finalize */
+    rx_buffer_reset (self);
+
+    g_mutex_unlock (&self->priv->mutex);
+
+    if (inner_error) {
+        g_propagate_error (error, inner_error);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*****************************************************************************/
+/* Auto-reconnect */
+
+static void device_command (QmiDevice *self,
+                            QmiMessage *message,
+                            guint timeout_ms,
+                            GCancellable *cancellable,
+                            GAsyncReadyCallback callback,
+                            gpointer user_data,
+                            gboolean internal);
+
+static gboolean reconnect_timeout (GWeakRef *ref);
+
+/* The reconnection sources only hold weak references, so that a device
+ * dropped while reconnecting still gets finalized, even from another
+ * thread */
+static GWeakRef *
+device_weak_ref_new (QmiDevice *self)
+{
+    GWeakRef *ref;
+
+    ref = g_slice_new (GWeakRef);
+    g_weak_ref_init (ref, self);
+    return ref;
+}
+
+static void
+device_weak_ref_free (GWeakRef *ref)
+{
+    g_weak_ref_clear (ref);
+    g_slice_free (GWeakRef, ref);
+}
 
-    /* We don't want to get the channel buffered */
-    g_io_channel_set_buffered (self->priv->iochannel, FALSE);
+/* Must be called with the device mutex held */
+static void
+reconnect_schedule (QmiDevice *self)
+{
+    GSource *source;
+
+    g_debug ("[%s] Trying to reopen the device in %u ms",
+             self->priv->path_display,
+             self->priv->reconnect_backoff_ms);
+
+    source = g_timeout_source_new (self->priv->reconnect_backoff_ms);
+    g_source_set_callback (source,
+                           (GSourceFunc)reconnect_timeout,
+                           device_weak_ref_new (self),
+                           (GDestroyNotify)device_weak_ref_free);
+    g_source_attach (source, self->priv->owner_context);
+    self->priv->reconnect_source = source;
+
+    self->priv->reconnect_backoff_ms = MIN (self->priv->reconnect_backoff_ms * 2,
+                                            RECONNECT_BACKOFF_MAX_MS);
+}
 
-    /* Let the GIOChannel own the FD */
-    g_io_channel_set_close_on_unref (self->priv->iochannel, TRUE);
+/* Must be called with the device mutex held */
+static void
+reconnect_unschedule (QmiDevice *self)
+{
+    if (self->priv->reconnect_source) {
+        g_source_destroy (self->priv->reconnect_source);
+        g_source_unref (self->priv->reconnect_source);
+        self->priv->reconnect_source = NULL;
+    }
+}
 
-    /* We don't want to get blocked while writing stuff */
-    if (!g_io_channel_set_flags (self->priv->iochannel,
-                                 G_IO_FLAG_NONBLOCK,
-                                 &inner_error)) {
-        g_prefix_error (&inner_error, "Cannot set non-blocking channel: ");
-        g_propagate_error (error, inner_error);
-        g_io_channel_shutdown (self->priv->iochannel, FALSE, NULL);
-        g_io_channel_unref (self->priv->iochannel);
-        self->priv->iochannel = NULL;
-        return FALSE;
+/* Must be called with the device mutex held */
+static void
+reconnect_monitor_stop (QmiDevice *self)
+{
+    if (self->priv->reconnect_monitor) {
+        g_file_monitor_cancel (self->priv->reconnect_monitor);
+        g_object_unref (self->priv->reconnect_monitor);
+        self->priv->reconnect_monitor = NULL;
     }
+}
 
-    self->priv->watch_id = g_io_add_watch (self->priv->iochannel,
-                                           G_IO_IN | G_IO_ERR | G_IO_HUP,
-                                           (GIOFunc)data_available,
-                                           self);
+static void
+reconnect_cancel (QmiDevice *self)
+{
+    g_mutex_lock (&self->priv->mutex);
+    self->priv->reconnect_pending = FALSE;
+    self->priv->reconnect_attempt++;
+    reconnect_unschedule (self);
+    reconnect_monitor_stop (self);
+    g_mutex_unlock (&self->priv->mutex);
+}
 
-    return !!self->priv->iochannel;
+/* Called when the device went away under our feet; the device gets closed,
+ * and reopened later if asked to */
+static void
+device_hangup (QmiDevice *self)
+{
+    close_fd (self, NULL);
+
+    g_mutex_lock (&self->priv->mutex);
+    if (self->priv->auto_reconnect) {
+        if (!self->priv->reconnect_pending) {
+            self->priv->reconnect_pending = TRUE;
+            self->priv->hangup_time = g_get_monotonic_time ();
+            self->priv->reconnect_backoff_ms = RECONNECT_BACKOFF_INITIAL_MS;
+        }
+        /* A hangup while the reopened device was being checked voids the
+         * check */
+        self->priv->reconnect_attempt++;
+        if (!self->priv->reconnect_source)
+            reconnect_schedule (self);
+    }
+    g_mutex_unlock (&self->priv->mutex);
 }
 
+/* Context of the checks done once the device is reopened */
 typedef struct {
     QmiDevice *self;
-    GSimpleAsyncResult *result;
-    GCancellable *cancellable;
-    QmiDeviceOpenFlags flags;
-    guint timeout;
-} DeviceOpenContext;
+    QmiClient *client; /* NULL for the version info check */
+    guint attempt;
+} ReconnectCheckContext;
+
+static ReconnectCheckContext *
+reconnect_check_context_new (QmiDevice *self,
+                             QmiClient *client,
+                             guint attempt)
+{
+    ReconnectCheckContext *ctx;
+
+    ctx = g_slice_new (ReconnectCheckContext);
+    ctx->self = g_object_ref (self);
+    ctx->client = client ? g_object_ref (client) : NULL;
+    ctx->attempt = attempt;
+    return ctx;
+}
 
 static void
-device_open_context_complete_and_free (DeviceOpenContext *ctx)
+reconnect_check_context_free (ReconnectCheckContext *ctx)
 {
-    g_simple_async_result_complete_in_idle (ctx->result);
-    g_object_unref (ctx->result);
-    if (ctx->cancellable)
-        g_object_unref (ctx->cancellable);
+    if (ctx->client)
+        g_object_unref (ctx->client);
     g_object_unref (ctx->self);
-    g_slice_free (DeviceOpenContext, ctx);
+    g_slice_free (ReconnectCheckContext, ctx);
 }
 
-/**
- * qmi_device_open_finish:
- * @self: a #QmiDevice.
- * @res: a #GAsyncResult.
- * @error: a #GError.
- *
- * Finishes an asynchronous open operation started with qmi_device_open_async().
- *
- * Returns: #TRUE if successful, #FALSE if @error is set.
- */
-gboolean
-qmi_device_open_finish (QmiDevice *self,
-                        GAsyncResult *res,
-                        GError **error)
+/* Must be called with the device mutex held */
+static gboolean
+reconnect_check_is_current (ReconnectCheckContext *ctx)
 {
-    return !g_simple_async_result_propagate_error (G_SIMPLE_ASYNC_RESULT (res), error);
+    /* Closed or reopened by the user, or hung up again, meanwhile */
+    return (ctx->self->priv->reconnect_pending &&
+            ctx->attempt == ctx->self->priv->reconnect_attempt);
 }
 
-static void process_open_flags (DeviceOpenContext *ctx);
+/* Must be called with the device mutex held */
+static void
+reconnect_complete (QmiDevice *self)
+{
+    self->priv->reconnect_pending = FALSE;
+    self->priv->reconnects++;
+    self->priv->last_reconnect_time = g_get_monotonic_time () - self->priv->hangup_time;
+    reconnect_monitor_stop (self);
+
+    g_debug ("[%s] Device reconnected after %" G_GUINT64_FORMAT " ms",
+             self->priv->path_display,
+             self->priv->last_reconnect_time / 1000);
+}
 
 static void
-sync_ready (QmiClientCtl *client_ctl,
-            GAsyncResult *res,
-            DeviceOpenContext *ctx)
+reconnect_probe_ready (QmiDevice *device,
+                       GAsyncResult *res,
+                       ReconnectCheckContext *ctx)
 {
+    QmiDevice *self = ctx->self;
     GError *error = NULL;
+    QmiMessage *reply;
+    gboolean lost = FALSE;
 
-    if (!qmi_client_ctl_sync_finish (client_ctl, res, &error)) {
-        g_prefix_error (&error, "Sync failed: ");
-        g_simple_async_result_take_error (ctx->result, error);
-        device_open_context_complete_and_free (ctx);
+    reply = qmi_device_command_finish (device, res, &error);
+
+    g_mutex_lock (&self->priv->mutex);
+
+    if (!reconnect_check_is_current (ctx)) {
+        g_mutex_unlock (&self->priv->mutex);
+        if (reply)
+            qmi_message_unref (reply);
+        if (error)
+            g_error_free (error);
+        reconnect_check_context_free (ctx);
         return;
     }
 
-    g_debug ("[%s] Sync operation finished",
-             ctx->self->priv->path_display);
+    /* Only an explicit invalid CID error means the client is gone; if the
+     * modem didn't answer, the client is kept */
+    if (!reply) {
+        g_debug ("[%s] Cannot probe QMI client for service '%s' with CID '%u': %s",
+                 self->priv->path_display,
+                 qmi_service_get_string (qmi_client_get_service (ctx->client)),
+                 qmi_client_get_cid (ctx->client),
+                 error->message);
+        g_error_free (error);
+    } else {
+        if (!qmi_message_get_response_result (reply, &error)) {
+            lost = g_error_matches (error,
+                                    QMI_PROTOCOL_ERROR,
+                                    QMI_PROTOCOL_ERROR_INVALID_CLIENT_ID);
+            g_error_free (error);
+        }
+        qmi_message_unref (reply);
+    }
 
-    /* Keep on with next flags */
-    process_open_flags (ctx);
+    if (lost)
+        unregister_client_unlocked (self, ctx->client);
+
+    if (--self->priv->reconnect_probes == 0)
+        reconnect_complete (self);
+
+    g_mutex_unlock (&self->priv->mutex);
+
+    if (lost) {
+        g_warning ("[%s] QMI client for service '%s' with CID '%u' was lost when reconnecting",
+                   self->priv->path_display,
+                   qmi_service_get_string (qmi_client_get_service (ctx->client)),
+                   qmi_client_get_cid (ctx->client));
+        g_signal_emit (self, signals[SIGNAL_CLIENT_LOST], 0, ctx->client);
+    }
+
+    reconnect_check_context_free (ctx);
 }
 
 static void
-version_info_ready (QmiClientCtl *client_ctl,
-                    GAsyncResult *res,
-                    DeviceOpenContext *ctx)
+reconnect_version_info_ready (QmiDevice *device,
+                              GAsyncResult *res,
+                              ReconnectCheckContext *ctx)
 {
+    QmiDevice *self = ctx->self;
     GError *error = NULL;
+    QmiMessage *reply;
+    GPtrArray *services = NULL;
+    GPtrArray *clients;
+    GHashTableIter iter;
+    QmiClient *client;
     guint i;
 
-    ctx->self->priv->supported_services = qmi_client_ctl_get_version_info_finish (client_ctl, res, &error);
-    if (!ctx->self->priv->supported_services) {
-        g_prefix_error (&error, "Version info check failed: ");
-        g_simple_async_result_take_error (ctx->result, error);
-        device_open_context_complete_and_free (ctx);
+    reply = qmi_device_command_finish (device, res, &error);
+    if (reply) {
+        services = qmi_message_ctl_version_info_reply_parse (reply, &error);
+        qmi_message_unref (reply);
+    }
+
+    g_mutex_lock (&self->priv->mutex);
+
+    if (!reconnect_check_is_current (ctx)) {
+        g_mutex_unlock (&self->priv->mutex);
+        if (services)
+            g_ptr_array_unref (services);
+        if (error)
+            g_error_free (error);
+        reconnect_check_context_free (ctx);
         return;
     }
 
-    g_debug ("[%s] QMI Device supports %u services:",
-             ctx->self->priv->path_display,
-             ctx->self->priv->supported_services->len);
-    for (i = 0; i < ctx->self->priv->supported_services->len; i++) {
-        QmiCtlVersionInfo *service;
+    /* The node is back but the modem isn't ready yet */
+    if (!services) {
+        g_debug ("[%s] Reopened device not responding: %s",
+                 self->priv->path_display,
+                 error->message);
+        g_error_free (error);
+        self->priv->reconnect_attempt++;
+        g_mutex_unlock (&self->priv->mutex);
+        close_fd (self, NULL);
+        g_mutex_lock (&self->priv->mutex);
+        if (self->priv->reconnect_pending && !self->priv->reconnect_source)
+            reconnect_schedule (self);
+        g_mutex_unlock (&self->priv->mutex);
+        reconnect_check_context_free (ctx);
+        return;
+    }
 
-        service = g_ptr_array_index (ctx->self->priv->supported_services, i);
-        g_debug ("[%s]    %s (%u.%u)",
-                 ctx->self->priv->path_display,
-                 qmi_service_get_string (qmi_ctl_version_info_get_service (service)),
-                 qmi_ctl_version_info_get_major_version (service),
-                 qmi_ctl_version_info_get_minor_version (service));
+    if (self->priv->supported_services)
+        g_ptr_array_unref (self->priv->supported_services);
+    self->priv->supported_services = services;
+
+    /* Clients keep their CIDs; probe them all before accepting commands */
+    clients = g_ptr_array_new_with_free_func (g_object_unref);
+    g_hash_table_iter_init (&iter, self->priv->registered_clients);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&client)) {
+        if (qmi_client_get_service (client) != QMI_SERVICE_CTL)
+            g_ptr_array_add (clients, g_object_ref (client));
     }
 
-    /* Keep on with next flags */
-    process_open_flags (ctx);
+    self->priv->reconnect_probes = clients->len;
+    if (clients->len == 0)
+        reconnect_complete (self);
+
+    g_mutex_unlock (&self->priv->mutex);
+
+    for (i = 0; i < clients->len; i++) {
+        QmiMessage *request;
+
+        client = g_ptr_array_index (clients, i);
+        request = qmi_message_new (qmi_client_get_service (client),
+                                   qmi_client_get_cid (client),
+                                   qmi_client_get_next_transaction_id (client),
+                                   RECONNECT_PROBE_MESSAGE_ID);
+        device_command (self,
+                        request,
+                        RECONNECT_CHECK_TIMEOUT_MS,
+                        NULL,
+                        (GAsyncReadyCallback)reconnect_probe_ready,
+                        reconnect_check_context_new (self, client, ctx->attempt),
+                        TRUE);
+        qmi_message_unref (request);
+    }
+
+    g_ptr_array_unref (clients);
+    reconnect_check_context_free (ctx);
 }
 
+static void reconnect_monitor_changed (GFileMonitor *monitor,
+                                       GFile *file,
+                                       GFile *other_file,
+                                       GFileMonitorEvent event_type,
+                                       GWeakRef *ref);
+
+/* Must be called from the owner context */
 static void
-process_open_flags (DeviceOpenContext *ctx)
+reconnect_monitor_start (QmiDevice *self)
 {
-    /* Query version info? */
-    if (ctx->flags & QMI_DEVICE_OPEN_FLAGS_VERSION_INFO) {
-        g_debug ("Checking version info...");
-        ctx->flags &= ~QMI_DEVICE_OPEN_FLAGS_VERSION_INFO;
-        qmi_client_ctl_get_version_info (ctx->self->priv->client_ctl,
-                                         ctx->timeout,
-                                         ctx->cancellable,
-                                         (GAsyncReadyCallback)version_info_ready,
-                                         ctx);
+    GFile *parent;
+    GFileMonitor *monitor;
+    GError *error = NULL;
+
+    if (self->priv->reconnect_monitor)
         return;
-    }
 
-    /* Sync? */
-    if (ctx->flags & QMI_DEVICE_OPEN_FLAGS_SYNC) {
-        g_debug ("Running sync...");
-        ctx->flags &= ~QMI_DEVICE_OPEN_FLAGS_SYNC;
-        qmi_client_ctl_sync (ctx->self->priv->client_ctl,
-                             ctx->timeout,
-                             ctx->cancellable,
-                             (GAsyncReadyCallback)sync_ready,
-                             ctx);
+    parent = g_file_get_parent (self->priv->file);
+    if (!parent)
+        return;
+
+    monitor = g_file_monitor_directory (parent, G_FILE_MONITOR_NONE, NULL, &error);
+    g_object_unref (parent);
+    if (!monitor) {
+        g_debug ("[%s] Cannot watch for the device to come back, retrying periodically: %s",
+                 self->priv->path_display,
+                 error->message);
+        g_error_free (error);
         return;
     }
 
-    /* No more flags to process, done we are */
-    g_simple_async_result_set_op_res_gboolean (ctx->result, TRUE);
-    device_open_context_complete_and_free (ctx);
+    g_signal_connect_data (monitor,
+                           "changed",
+                           G_CALLBACK (reconnect_monitor_changed),
+                           device_weak_ref_new (self),
+                           (GClosureNotify)device_weak_ref_free,
+                           0);
+
+    g_mutex_lock (&self->priv->mutex);
+    self->priv->reconnect_monitor = monitor;
+    g_mutex_unlock (&self->priv->mutex);
 }
 
-/**
- * qmi_device_open:
- * @self: a #QmiDevice.
- * @flags: mask of #QmiDeviceOpenFlags specifying how the device should be opened.
- * @timeout: maximum time, in seconds, to wait for the device to be opened.
- * @cancellable: optional #GCancellable object, #NULL to ignore.
- * @callback: a #GAsyncReadyCallback to call when the operation is finished.
- * @user_data: the data to pass to callback function.
- *
- * Asynchronously opens a #QmiDevice for I/O.
- *
- * When the operation is finished @callback will be called. You can then call
- * qmi_device_open_finish() to get the result of the operation.
- */
-void
-qmi_device_open (QmiDevice *self,
-                 QmiDeviceOpenFlags flags,
-                 guint timeout,
-                 GCancellable *cancellable,
-                 GAsyncReadyCallback callback,
-                 gpointer user_data)
+/* Must be called from the owner context */
+static void
+reconnect_try (QmiDevice *self)
 {
-    DeviceOpenContext *ctx;
     GError *error = NULL;
+    QmiMessage *request;
+    guint attempt;
 
-    g_return_if_fail (QMI_IS_DEVICE (self));
+    /* Replies and monitor events are then reported in the owner context */
+    g_main_context_push_thread_default (self->priv->owner_context);
 
-    ctx = g_slice_new (DeviceOpenContext);
-    ctx->self = g_object_ref (self);
-    ctx->result = g_simple_async_result_new (G_OBJECT (self),
-                                             callback,
-                                             user_data,
-                                             qmi_device_open);
-    ctx->flags = flags;
-    ctx->timeout = timeout;
-    ctx->cancellable = (cancellable ? g_object_ref (cancellable) : NULL);
+    /* Watch before trying, so that a node appearing right after a failed
+     * attempt isn't missed */
+    reconnect_monitor_start (self);
 
-    if (!create_iochannel (self, &error)) {
-        g_prefix_error (&error,
-                        "Cannot open QMI device: ");
-        g_simple_async_result_take_error (ctx->result, error);
-        device_open_context_complete_and_free (ctx);
+    /* Node not there yet? */
+    if (!open_fd (self, &error)) {
+        g_debug ("[%s] Cannot reopen device yet: %s",
+                 self->priv->path_display,
+                 error->message);
+        g_error_free (error);
+        g_mutex_lock (&self->priv->mutex);
+        if (self->priv->reconnect_pending && !self->priv->reconnect_source)
+            reconnect_schedule (self);
+        g_mutex_unlock (&self->priv->mutex);
+        g_main_context_pop_thread_default (self->priv->owner_context);
         return;
     }
 
-    /* Process all open flags */
-    process_open_flags (ctx);
+    g_mutex_lock (&self->priv->mutex);
+    attempt = ++self->priv->reconnect_attempt;
+    g_mutex_unlock (&self->priv->mutex);
+
+    /* Make sure the modem talks to us before restoring the clients */
+    request = qmi_message_ctl_version_info_new (
+        qmi_client_get_next_transaction_id (QMI_CLIENT (self->priv->client_ctl)));
+    device_command (self,
+                    request,
+                    RECONNECT_CHECK_TIMEOUT_MS,
+                    NULL,
+                    (GAsyncReadyCallback)reconnect_version_info_ready,
+                    reconnect_check_context_new (self, NULL, attempt),
+                    TRUE);
+    qmi_message_unref (request);
+
+    g_main_context_pop_thread_default (self->priv->owner_context);
 }
 
-/*****************************************************************************/
-/* Close channel */
-
 static gboolean
-destroy_iochannel (QmiDevice *self,
-                   GError **error)
+reconnect_timeout (GWeakRef *ref)
 {
-    GError *inner_error = NULL;
+    QmiDevice *self;
+    gboolean pending;
 
-    /* Already closed? */
-    if (!self->priv->iochannel)
-        return TRUE;
+    self = g_weak_ref_get (ref);
+    if (!self)
+        return FALSE;
 
-    g_io_channel_shutdown (self->priv->iochannel, TRUE, &inner_error);
+    g_mutex_lock (&self->priv->mutex);
+    /* May have been cancelled while being dispatched */
+    if (self->priv->reconnect_source == g_main_current_source ()) {
+        g_source_unref (self->priv->reconnect_source);
+        self->priv->reconnect_source = NULL;
+    }
+    pending = self->priv->reconnect_pending;
+    g_mutex_unlock (&self->priv->mutex);
 
-    /* Failures when closing still make the device to get closed */
-    g_io_channel_unref (self->priv->iochannel);
-    self->priv->iochannel = NULL;
-    self->priv->watch_id = 0;
-    if (self->priv->response) {
-        g_byte_array_unref (self->priv->response);
-        self->priv->response = NULL;
+    if (pending)
+        reconnect_try (self);
+
+    g_object_unref (self);
+    return FALSE;
+}
+
+static void
+reconnect_monitor_changed (GFileMonitor *monitor,
+                           GFile *file,
+                           GFile *other_file,
+                           GFileMonitorEvent event_type,
+                           GWeakRef *ref)
+{
+    QmiDevice *self;
+
+    /* udev may only set the permissions after creating the node */
+    if (event_type != G_FILE_MONITOR_EVENT_CREATED &&
+        event_type != G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED)
+        return;
+
+    self = g_weak_ref_get (ref);
+    if (!self)
+        return;
+
+    if (!g_file_equal (file, self->priv->file)) {
+        g_object_unref (self);
+        return;
     }
 
-    if (inner_error) {
-        g_propagate_error (error, inner_error);
-        return FALSE;
+    g_mutex_lock (&self->priv->mutex);
+    /* Not reconnecting, or already reopened and being checked */
+    if (!self->priv->reconnect_pending || self->priv->fd >= 0) {
+        g_mutex_unlock (&self->priv->mutex);
+        g_object_unref (self);
+        return;
     }
+    /* Retry right away, and quickly again if not ready yet */
+    reconnect_unschedule (self);
+    self->priv->reconnect_backoff_ms = RECONNECT_BACKOFF_INITIAL_MS;
+    g_mutex_unlock (&self->priv->mutex);
 
-    return TRUE;
+    g_debug ("[%s] Device file is back",
+             self->priv->path_display);
+    reconnect_try (self);
+    g_object_unref (self);
 }
 
 /**
@@ -1242,7 +3099,9 @@ qmi_device_close (QmiDevice *self,
 {
     g_return_val_if_fail (QMI_IS_DEVICE (self), FALSE);
 
-    if (!destroy_iochannel (self, error)) {
+    reconnect_cancel (self);
+
+    if (!close_fd (self, error)) {
         g_prefix_error (error,
                         "Cannot close QMI device: ");
         return FALSE;
@@ -1273,26 +3132,102 @@ qmi_device_command (QmiDevice *self,
                     GCancellable *cancellable,
                     GAsyncReadyCallback callback,
                     gpointer user_data)
+{
+    qmi_device_command_ms (self,
+                           message,
+                           qmi_utils_timeout_to_ms (timeout),
+                           cancellable,
+                           callback,
+                           user_data);
+}
+
+/**
+ * qmi_device_command_ms:
+ * @self: a #QmiDevice.
+ * @message: the #QmiMessage to send.
+ * @timeout_ms: maximum time to wait for the response, in milliseconds.
+ * @cancellable: optional #GCancellable object, #NULL to ignore.
+ * @callback: a #GAsyncReadyCallback to call when the operation is finished.
+ * @user_data: the data to pass to callback function.
+ *
+ * Like qmi_device_command(), but with the timeout given in milliseconds.
+ * The deadline is tracked with the monotonic clock.
+ *
+ * If @cancellable is cancelled before the response arrives, the operation
+ * finishes with %G_IO_ERROR_CANCELLED and any late response is discarded.
+ *
+ * When the operation is finished, @callback will be called. You can then call
+ * qmi_device_command_finish() to get the result of the operation.
+ */
+void
+qmi_device_command_ms (QmiDevice *self,
+                       QmiMessage *message,
+                       guint timeout_ms,
+                       GCancellable *cancellable,
+                       GAsyncReadyCallback callback,
+                       gpointer user_data)
+{
+    g_return_if_fail (QMI_IS_DEVICE (self));
+    g_return_if_fail (message != NULL);
+
+    device_command (self,
+                    message,
+                    timeout_ms,
+                    cancellable,
+                    callback,
+                    user_data,
+                    FALSE);
+}
+
+/* Internal commands are the checks done while reconnecting, which must go
+ * out before the device accepts user commands again */
+static void
+device_command (QmiDevice *self,
+                QmiMessage *message,
+                guint timeout_ms,
+                GCancellable *cancellable,
+                GAsyncReadyCallback callback,
+                gpointer user_data,
+                gboolean internal)
 {
     GError *error = NULL;
+    Transaction record;
     Transaction *tr;
     gconstpointer raw_message;
     gsize raw_message_len;
-    gsize written;
-    GIOStatus write_status;
 
-    g_return_if_fail (QMI_IS_DEVICE (self));
-    g_return_if_fail (message != NULL);
+    /* Already cancelled, don't even send it */
+    if (g_cancellable_set_error_if_cancelled (cancellable, &error)) {
+        g_simple_async_report_take_gerror_in_idle (G_OBJECT (self),
+                                                   callback,
+                                                   user_data,
+                                                   error);
+        return;
+    }
+
+    g_mutex_lock (&self->priv->mutex);
+
+    transaction_init (&record, self, message, callback, user_data);
 
-    tr = transaction_new (self, message, callback, user_data);
+    /* Device must not be reconnecting */
+    if (self->priv->reconnect_pending && !internal) {
+        error = g_error_new (QMI_CORE_ERROR,
+                             QMI_CORE_ERROR_WRONG_STATE,
+                             "Device is being reconnected");
+        transaction_complete (&record, NULL, error);
+        g_error_free (error);
+        g_mutex_unlock (&self->priv->mutex);
+        return;
+    }
 
     /* Device must be open */
-    if (!self->priv->iochannel) {
+    if (self->priv->fd < 0) {
         error = g_error_new (QMI_CORE_ERROR,
                              QMI_CORE_ERROR_WRONG_STATE,
                              "Device must be open to send commands");
-        transaction_complete_and_free (tr, NULL, error);
+        transaction_complete (&record, NULL, error);
         g_error_free (error);
+        g_mutex_unlock (&self->priv->mutex);
         return;
     }
 
@@ -1303,8 +3238,9 @@ qmi_device_command (QmiDevice *self,
                              QMI_CORE_ERROR_FAILED,
                              "Cannot send message in service '%s' without a CID",
                              qmi_service_get_string (qmi_message_get_service (message)));
-        transaction_complete_and_free (tr, NULL, error);
+        transaction_complete (&record, NULL, error);
         g_error_free (error);
+        g_mutex_unlock (&self->priv->mutex);
         return;
     }
 
@@ -1324,47 +3260,37 @@ qmi_device_command (QmiDevice *self,
     raw_message = qmi_message_get_raw (message, &raw_message_len, &error);
     if (!raw_message) {
         g_prefix_error (&error, "Cannot get raw message: ");
-        transaction_complete_and_free (tr, NULL, error);
+        transaction_complete (&record, NULL, error);
         g_error_free (error);
+        g_mutex_unlock (&self->priv->mutex);
         return;
     }
 
-    /* Setup context to match response */
-    device_store_transaction (self, tr, timeout);
-
-    written = 0;
-    write_status = G_IO_STATUS_AGAIN;
-    while (write_status == G_IO_STATUS_AGAIN) {
-        write_status = g_io_channel_write_chars (self->priv->iochannel,
-                                                 raw_message,
-                                                 (gssize)raw_message_len,
-                                                 &written,
-                                                 &error);
-        switch (write_status) {
-        case G_IO_STATUS_ERROR:
-            g_prefix_error (&error, "Cannot write message: ");
-
-            /* Match transaction so that we remove it from our tracking table */
-            tr = device_match_transaction (self, message);
-            transaction_complete_and_free (tr, NULL, error);
-            g_error_free (error);
-            return;
+    record.raw = raw_message;
+    record.raw_len = raw_message_len;
 
-        case G_IO_STATUS_EOF:
-            /* We shouldn't get EOF when writing */
-            g_assert_not_reached ();
-            break;
+    /* Setup context to match response */
+    tr = device_store_transaction (self, &record, timeout_ms);
+    if (cancellable)
+        transaction_watch_cancellable (tr, cancellable);
+
+    /* Wait for room in the in-flight window if needed; requests already
+     * waiting go first */
+    if (!g_queue_is_empty (&self->priv->pending_queue) ||
+        !in_flight_window_allows (self, tr)) {
+        g_queue_push_tail (&self->priv->pending_queue, tr);
+        tr->pending_link = self->priv->pending_queue.tail;
+        pending_queue_pump (self);
+        g_mutex_unlock (&self->priv->mutex);
+        return;
+    }
 
-        case G_IO_STATUS_NORMAL:
-            /* All good, we'll exit the loop now */
-            break;
+    /* Queue the message; if nothing else was pending, write right away */
+    transaction_queue_write (self, tr);
+    if (!self->priv->tx_blocked)
+        write_queue_flush (self);
 
-        case G_IO_STATUS_AGAIN:
-            /* We're in a non-blocking channel and therefore we're up to receive
-             * EAGAIN; just retry in this case. TODO: in an idle? */
-            break;
-        }
-    }
+    g_mutex_unlock (&self->priv->mutex);
 
     /* Just return, we'll get response asynchronously */
 }
@@ -1553,6 +3479,7 @@ set_property (GObject *object,
         self->priv->path_display = g_filename_display_name (self->priv->path);
         break;
     case PROP_CLIENT_CTL:
+    case PROP_BACKPRESSURE:
         /* Not writable */
         g_assert_not_reached ();
         break;
@@ -1577,6 +3504,9 @@ get_property (GObject *object,
     case PROP_CLIENT_CTL:
         g_value_set_object (value, self->priv->client_ctl);
         break;
+    case PROP_BACKPRESSURE:
+        g_value_set_boolean (value, qmi_device_get_backpressure (self));
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         break;
@@ -1594,6 +3524,17 @@ qmi_device_init (QmiDevice *self)
                                                             g_direct_equal,
                                                             NULL,
                                                             g_object_unref);
+    self->priv->service_clients = g_hash_table_new_full (g_direct_hash,
+                                                         g_direct_equal,
+                                                         NULL,
+                                                         (GDestroyNotify)g_ptr_array_unref);
+    self->priv->client_in_flight = g_hash_table_new (g_direct_hash,
+                                                     g_direct_equal);
+    g_queue_init (&self->priv->pending_queue);
+    g_queue_init (&self->priv->indication_queue);
+    self->priv->tx_frames = g_array_new (FALSE, FALSE, sizeof (TxFrame));
+    self->priv->fd = -1;
+    g_mutex_init (&self->priv->mutex);
 }
 
 static gboolean
@@ -1624,6 +3565,7 @@ dispose (GObject *object)
     g_hash_table_foreach_remove (self->priv->registered_clients,
                                  (GHRFunc)foreach_warning,
                                  self);
+    g_hash_table_remove_all (self->priv->service_clients);
 
     g_clear_object (&self->priv->client_ctl);
 
@@ -1635,24 +3577,61 @@ finalize (GObject *object)
 {
     QmiDevice *self = QMI_DEVICE (object);
 
+    /* The I/O thread may still be dispatching the device sources when the
+     * last reference is dropped from another thread, or keep on running for
+     * a while when dropped from the I/O thread itself; remove the sources
+     * which don't hold a reference to the device, and stop the thread,
+     * before freeing anything they touch */
+    if (self->priv->fd_source) {
+        g_source_destroy (self->priv->fd_source);
+        g_source_unref (self->priv->fd_source);
+        self->priv->fd_source = NULL;
+    }
+    if (self->priv->timeout_source) {
+        g_source_destroy (self->priv->timeout_source);
+        g_source_unref (self->priv->timeout_source);
+        self->priv->timeout_source = NULL;
+    }
+    if (self->priv->io_thread)
+        io_thread_stop (self);
+
     /* Transactions keep refs to the device, so it's actually
-     * impossible to have any content in the HT */
+     * impossible to have any content in the table */
     if (self->priv->transactions) {
-        g_assert (g_hash_table_size (self->priv->transactions) == 0);
-        g_hash_table_unref (self->priv->transactions);
+        g_assert (self->priv->n_transactions == 0);
+        g_free (self->priv->transactions);
+        g_ptr_array_unref (self->priv->timeouts);
     }
 
     g_hash_table_unref (self->priv->registered_clients);
+    g_hash_table_unref (self->priv->service_clients);
+    g_hash_table_unref (self->priv->client_in_flight);
+    if (self->priv->reconnect_source) {
+        g_source_destroy (self->priv->reconnect_source);
+        g_source_unref (self->priv->reconnect_source);
+    }
+    if (self->priv->reconnect_monitor) {
+        g_file_monitor_cancel (self->priv->reconnect_monitor);
+        g_object_unref (self->priv->reconnect_monitor);
+    }
 
     if (self->priv->supported_services)
         g_ptr_array_unref (self->priv->supported_services);
 
     g_free (self->priv->path);
     g_free (self->priv->path_display);
-    if (self->priv->response)
-        g_byte_array_unref (self->priv->response);
-    if (self->priv->iochannel)
-        g_io_channel_unref (self->priv->iochannel);
+    g_free (self->priv->rx_buffer);
+    write_queue_clear (self);
+    g_array_unref (self->priv->tx_frames);
+    if (self->priv->completed_results)
+        g_ptr_array_unref (self->priv->completed_results);
+    if (self->priv->fd >= 0)
+        close (self->priv->fd);
+    if (self->priv->owner_context)
+        g_main_context_unref (self->priv->owner_context);
+    g_mutex_clear (&self->priv->mutex);
+    if (self->priv->message_pool)
+        qmi_message_pool_unref (self->priv->message_pool);
 
     G_OBJECT_CLASS (qmi_device_parent_class)->finalize (object);
 }
@@ -1691,4 +3670,34 @@ qmi_device_class_init (QmiDeviceClass *klass)
                              QMI_TYPE_CLIENT_CTL,
                              G_PARAM_READABLE);
     g_object_class_install_property (object_class, PROP_CLIENT_CTL, properties[PROP_CLIENT_CTL]);
+
+    properties[PROP_BACKPRESSURE] =
+        g_param_spec_boolean (QMI_DEVICE_BACKPRESSURE,
+                              "Backpressure",
+                              "Whether requests are waiting for room in the in-flight window",
+                              FALSE,
+                              G_PARAM_READABLE);
+    g_object_class_install_property (object_class, PROP_BACKPRESSURE, properties[PROP_BACKPRESSURE]);
+
+    /**
+     * QmiDevice::client-lost:
+     * @self: the #QmiDevice.
+     * @client: the #QmiClient whose CID is no longer valid.
+     *
+     * Emitted after an automatic reconnection for every client the modem
+     * no longer knows. The client is not registered in the device anymore,
+     * so it won't get indications, and its commands will fail; a new one
+     * needs to be allocated.
+     */
+    signals[SIGNAL_CLIENT_LOST] =
+        g_signal_new (QMI_DEVICE_SIGNAL_CLIENT_LOST,
+                      G_OBJECT_CLASS_TYPE (object_class),
+                      G_SIGNAL_RUN_LAST,
+                      0,
+                      NULL,
+                      NULL,
+                      g_cclosure_marshal_VOID__OBJECT,
+                      G_TYPE_NONE,
+                      1,
+                      QMI_TYPE_CLIENT);
 }
@@ -42,8 +42,11 @@ typedef struct _QmiDevice QmiDevice;
 typedef struct _QmiDeviceClass QmiDeviceClass;
 typedef struct _QmiDevicePrivate QmiDevicePrivate;
 
-#define QMI_DEVICE_FILE       "device-file"
-#define QMI_DEVICE_CLIENT_CTL "device-client-ctl"
+#define QMI_DEVICE_FILE         "device-file"
+#define QMI_DEVICE_CLIENT_CTL   "device-client-ctl"
+#define QMI_DEVICE_BACKPRESSURE "device-backpressure"
+
+#define QMI_DEVICE_SIGNAL_CLIENT_LOST "client-lost"
 
 struct _QmiDevice {
     GObject parent;
@@ -69,18 +72,69 @@ const gchar  *qmi_device_get_path         (QmiDevice *self);
 const gchar  *qmi_device_get_path_display (QmiDevice *self);
 gboolean      qmi_device_is_open          (QmiDevice *self);
 
+/**
+ * QmiDeviceStats:
+ * @message_pool_hits: number of received messages reusing a pooled block.
+ * @message_pool_misses: number of received messages needing a new allocation.
+ * @write_queue_depth: number of messages queued and not fully written yet.
+ * @write_bytes_pending: number of queued bytes not written yet.
+ * @rx_bytes_dropped: number of received bytes discarded, either while
+ *  resynchronising framing or as part of invalid messages.
+ * @rx_frames_dropped: number of framing errors and invalid messages found.
+ * @in_flight: number of requests sent and waiting for a response.
+ * @pending_queue_depth: number of requests waiting for room in the in-flight window.
+ * @read_syscalls: number of read() calls done on the device.
+ * @write_syscalls: number of writev() calls done on the device.
+ * @frames_received: number of frames read from the device.
+ * @reconnects: number of times the device was reopened automatically after a hangup.
+ * @last_reconnect_time: time from the last hangup until the device was reopened, in microseconds.
+ *
+ * I/O statistics of a #QmiDevice.
+ */
+typedef struct {
+    guint64 message_pool_hits;
+    guint64 message_pool_misses;
+    guint write_queue_depth;
+    gsize write_bytes_pending;
+    guint64 rx_bytes_dropped;
+    guint64 rx_frames_dropped;
+    guint in_flight;
+    guint pending_queue_depth;
+    guint64 read_syscalls;
+    guint64 write_syscalls;
+    guint64 frames_received;
+    guint reconnects;
+    guint64 last_reconnect_time;
+} QmiDeviceStats;
+
+void qmi_device_get_stats (QmiDevice *self,
+                           QmiDeviceStats *stats);
+
+void     qmi_device_set_in_flight_window (QmiDevice *self,
+                                          guint max_per_client,
+                                          guint max_per_service);
+gboolean qmi_device_get_backpressure     (QmiDevice *self);
+
 /**
  * QmiDeviceOpenFlags:
  * @QMI_DEVICE_OPEN_FLAGS_NONE: No flags.
  * @QMI_DEVICE_OPEN_FLAGS_VERSION_INFO: Run version info check when opening.
  * @QMI_DEVICE_OPEN_FLAGS_SYNC: Synchronize with endpoint once the device is open. Will release any previously allocated client ID.
+ * @QMI_DEVICE_OPEN_FLAGS_MESSAGE_POOL: Allocate received messages from a per-device pool.
+ * @QMI_DEVICE_OPEN_FLAGS_IO_THREAD: Run reads, writes and transaction matching in a dedicated thread. Results and indications are still reported in the main context the requests were issued from.
+ * @QMI_DEVICE_OPEN_FLAGS_DIRECT_COMPLETION: Complete commands in the same main loop dispatch that read their response, instead of in an idle. Only used if the device runs in the global default main context, without %QMI_DEVICE_OPEN_FLAGS_IO_THREAD, and only for commands issued from that same context; the others are still completed in an idle.
+ * @QMI_DEVICE_OPEN_FLAGS_AUTO_RECONNECT: If the device hangs up, reopen it as soon as the device file is back, or else retry with exponential backoff, keeping the registered clients and their CIDs. Commands fail with %QMI_CORE_ERROR_WRONG_STATE until the modem answers and every CID is checked; clients the modem no longer knows are reported with #QmiDevice::client-lost.
  *
  * Flags to specify which actions to be performed when the device is open.
  */
 typedef enum {
-    QMI_DEVICE_OPEN_FLAGS_NONE         = 0,
-    QMI_DEVICE_OPEN_FLAGS_VERSION_INFO = 1 << 0,
-    QMI_DEVICE_OPEN_FLAGS_SYNC         = 1 << 1
+    QMI_DEVICE_OPEN_FLAGS_NONE              = 0,
+    QMI_DEVICE_OPEN_FLAGS_VERSION_INFO      = 1 << 0,
+    QMI_DEVICE_OPEN_FLAGS_SYNC              = 1 << 1,
+    QMI_DEVICE_OPEN_FLAGS_MESSAGE_POOL      = 1 << 2,
+    QMI_DEVICE_OPEN_FLAGS_IO_THREAD         = 1 << 3,
+    QMI_DEVICE_OPEN_FLAGS_DIRECT_COMPLETION = 1 << 4,
+    QMI_DEVICE_OPEN_FLAGS_AUTO_RECONNECT    = 1 << 5
 } QmiDeviceOpenFlags;
 
 void         qmi_device_open        (QmiDevice *self,
@@ -89,6 +143,12 @@ void         qmi_device_open        (QmiDevice *self,
                                      GCancellable *cancellable,
                                      GAsyncReadyCallback callback,
                                      gpointer user_data);
+void         qmi_device_open_ms     (QmiDevice *self,
+                                     QmiDeviceOpenFlags flags,
+                                     guint timeout_ms,
+                                     GCancellable *cancellable,
+                                     GAsyncReadyCallback callback,
+                                     gpointer user_data);
 gboolean     qmi_device_open_finish (QmiDevice *self,
                                      GAsyncResult *res,
                                      GError **error);
@@ -136,6 +196,12 @@ void         qmi_device_command        (QmiDevice *self,
                                         GCancellable *cancellable,
                                         GAsyncReadyCallback callback,
                                         gpointer user_data);
+void         qmi_device_command_ms     (QmiDevice *self,
+                                        QmiMessage *message,
+                                        guint timeout_ms,
+                                        GCancellable *cancellable,
+                                        GAsyncReadyCallback callback,
+                                        gpointer user_data);
 QmiMessage  *qmi_device_command_finish (QmiDevice *self,
                                         GAsyncResult *res,
                                         GError **error);
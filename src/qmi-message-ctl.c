@@ -128,10 +128,19 @@ qmi_ctl_version_info_unref (QmiCtlVersionInfo *info)
 QmiMessage *
 qmi_message_ctl_version_info_new (guint8 transaction_id)
 {
-    return qmi_message_new (QMI_SERVICE_CTL,
-                            0,
-                            transaction_id,
-                            QMI_CTL_MESSAGE_GET_VERSION_INFO);
+    QmiMessage *message;
+    GError *error = NULL;
+
+    message = qmi_message_builder_finish (
+        qmi_message_builder_new (QMI_SERVICE_CTL,
+                                 0,
+                                 transaction_id,
+                                 QMI_CTL_MESSAGE_GET_VERSION_INFO,
+                                 0),
+        &error);
+    g_assert_no_error (error);
+
+    return message;
 }
 
 struct qmi_ctl_version_info_list_service {
@@ -209,23 +218,19 @@ QmiMessage *
 qmi_message_ctl_allocate_cid_new (guint8 transaction_id,
                                   QmiService service)
 {
+    QmiMessageBuilder *builder;
     QmiMessage *message;
-    guint8 service_id;
     GError *error = NULL;
 
     g_assert (service != QMI_SERVICE_UNKNOWN);
-    service_id = service;
-
-    message = qmi_message_new (QMI_SERVICE_CTL,
-                               0,
-                               transaction_id,
-                               QMI_CTL_MESSAGE_ALLOCATE_CLIENT_ID);
-
-    qmi_message_tlv_add (message,
-                         (guint8)0x01,
-                         sizeof (service_id),
-                         &service_id,
-                         &error);
+
+    builder = qmi_message_builder_new (QMI_SERVICE_CTL,
+                                       0,
+                                       transaction_id,
+                                       QMI_CTL_MESSAGE_ALLOCATE_CLIENT_ID,
+                                       3 + sizeof (guint8));
+    qmi_message_builder_add_u8 (builder, 0x01, (guint8)service);
+    message = qmi_message_builder_finish (builder, &error);
     g_assert_no_error (error);
 
     return message;
@@ -271,6 +276,7 @@ qmi_message_ctl_release_cid_new (guint8 transaction_id,
                                  QmiService service,
                                  guint8 cid)
 {
+    QmiMessageBuilder *builder;
     QmiMessage *message;
     GError *error = NULL;
     struct qmi_ctl_cid id;
@@ -279,16 +285,13 @@ qmi_message_ctl_release_cid_new (guint8 transaction_id,
     id.service_type = (guint8)service;
     id.cid = cid;
 
-    message = qmi_message_new (QMI_SERVICE_CTL,
-                               0,
-                               transaction_id,
-                               QMI_CTL_MESSAGE_RELEASE_CLIENT_ID);
-
-    qmi_message_tlv_add (message,
-                         (guint8)0x01,
-                         sizeof (id),
-                         &id,
-                         &error);
+    builder = qmi_message_builder_new (QMI_SERVICE_CTL,
+                                       0,
+                                       transaction_id,
+                                       QMI_CTL_MESSAGE_RELEASE_CLIENT_ID,
+                                       3 + sizeof (id));
+    qmi_message_builder_add_raw (builder, 0x01, &id, sizeof (id));
+    message = qmi_message_builder_finish (builder, &error);
     g_assert_no_error (error);
 
     return message;
@@ -327,8 +330,17 @@ qmi_message_ctl_release_cid_reply_parse (QmiMessage *self,
 QmiMessage *
 qmi_message_ctl_sync_new (guint8 transaction_id)
 {
-    return qmi_message_new (QMI_SERVICE_CTL,
-                            0,
-                            transaction_id,
-                            QMI_CTL_MESSAGE_SYNC);
+    QmiMessage *message;
+    GError *error = NULL;
+
+    message = qmi_message_builder_finish (
+        qmi_message_builder_new (QMI_SERVICE_CTL,
+                                 0,
+                                 transaction_id,
+                                 QMI_CTL_MESSAGE_SYNC,
+                                 0),
+        &error);
+    g_assert_no_error (error);
+
+    return message;
 }
@@ -47,6 +47,17 @@ struct _QmiDmsGetIdsOutput {
     gchar *meid;
 };
 
+static gchar *
+get_ids_reply_dup_string (QmiMessage *self,
+                          guint8 type)
+{
+    const gchar *view;
+    gsize length;
+
+    view = qmi_message_tlv_peek_string (self, type, &length);
+    return view ? g_strndup (view, length) : NULL;
+}
+
 /**
  * qmi_dms_get_ids_output_get_result:
  * @output: a #QmiDmsGetIdsOutput.
@@ -163,10 +174,19 @@ QmiMessage *
 qmi_message_dms_get_ids_new (guint8 transaction_id,
                              guint8 client_id)
 {
-    return qmi_message_new (QMI_SERVICE_DMS,
-                            client_id,
-                            transaction_id,
-                            QMI_DMS_MESSAGE_GET_IDS);
+    QmiMessage *message;
+    GError *error = NULL;
+
+    message = qmi_message_builder_finish (
+        qmi_message_builder_new (QMI_SERVICE_DMS,
+                                 client_id,
+                                 transaction_id,
+                                 QMI_DMS_MESSAGE_GET_IDS,
+                                 0),
+        &error);
+    g_assert_no_error (error);
+
+    return message;
 }
 
 QmiDmsGetIdsOutput *
@@ -193,16 +213,11 @@ qmi_message_dms_get_ids_reply_parse (QmiMessage *self,
     output->ref_count = 1;
     output->error = inner_error;
 
-    /* Note: all ESN/IMEI/MEID are OPTIONAL; so it's ok if none of them appear */
-    output->esn = qmi_message_tlv_get_string (self,
-                                              QMI_DMS_TLV_GET_IDS_ESN,
-                                              NULL);
-    output->imei = qmi_message_tlv_get_string (self,
-                                               QMI_DMS_TLV_GET_IDS_IMEI,
-                                               NULL);
-    output->meid = qmi_message_tlv_get_string (self,
-                                               QMI_DMS_TLV_GET_IDS_MEID,
-                                               NULL);
+    /* Note: all ESN/IMEI/MEID are OPTIONAL; so it's ok if none of them appear.
+     * They are copied right away, so that the reply isn't kept around. */
+    output->esn = get_ids_reply_dup_string (self, QMI_DMS_TLV_GET_IDS_ESN);
+    output->imei = get_ids_reply_dup_string (self, QMI_DMS_TLV_GET_IDS_IMEI);
+    output->meid = get_ids_reply_dup_string (self, QMI_DMS_TLV_GET_IDS_MEID);
 
     return output;
 }
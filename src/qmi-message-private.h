@@ -0,0 +1,53 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2012 Aleksander Morgado <aleksander@lanedo.com>
+ */
+
+/* NOTE: this is a private non-installable header */
+
+#ifndef _LIBQMI_GLIB_QMI_MESSAGE_PRIVATE_H_
+#define _LIBQMI_GLIB_QMI_MESSAGE_PRIVATE_H_
+
+#include <glib.h>
+
+#include "qmi-message.h"
+
+G_BEGIN_DECLS
+
+/* Header fields, decoded once when the message is created. A QmiMessage
+ * starts with its QmiMessageHeader, so the routing code can read them with
+ * QMI_MESSAGE_HEADER() and skip the checks done by the public getters. */
+typedef struct {
+    guint8 service;
+    guint8 client_id;
+    guint8 qmux_flags;
+    guint8 qmi_flags;
+    guint16 transaction_id;
+    guint16 message_id;
+    guint8 is_response;
+    guint8 is_indication;
+} QmiMessageHeader;
+
+#define QMI_MESSAGE_HEADER(self) ((const QmiMessageHeader *)(self))
+
+G_END_DECLS
+
+#endif /* _LIBQMI_GLIB_QMI_MESSAGE_PRIVATE_H_ */
@@ -21,34 +21,16 @@
  * Copyright (C) 2012 Aleksander Morgado <aleksander@lanedo.com>
  */
 
-#include <string.h>
-
 #include "qmi-message-wds.h"
+#include "qmi-message-wds-generated.h"
 #include "qmi-enums.h"
-#include "qmi-error-types.h"
+
+/* Types, builders and reply parsers are generated from
+ * data/qmi-service-wds.json; only the field accessors live here. */
 
 /*****************************************************************************/
 /* Start network */
 
-enum {
-  QMI_WDS_TLV_START_NETWORK_APN      = 0x14,
-  QMI_WDS_TLV_START_NETWORK_USERNAME = 0x17,
-  QMI_WDS_TLV_START_NETWORK_PASSWORD = 0x18
-};
-
-/**
- * QmiWdsStartNetworkInput:
- *
- * An opaque type handling the input arguments that may be passed to the Start
- * Network operation in the WDS service.
- */
-struct _QmiWdsStartNetworkInput {
-    volatile gint ref_count;
-    gchar *apn;
-    gchar *username;
-    gchar *password;
-};
-
 /**
  * qmi_wds_start_network_input_set_apn:
  * @input: a #QmiWdsStartNetworkInput.
@@ -148,166 +130,6 @@ qmi_wds_start_network_input_get_password (QmiWdsStartNetworkInput *input)
     return input->password;
 }
 
-/**
- * qmi_wds_start_network_input_new:
- *
- * Allocates a new #QmiWdsStartNetworkInput.
- *
- * Returns: the newly created #QmiWdsStartNetworkInput.
- */
-QmiWdsStartNetworkInput *
-qmi_wds_start_network_input_new (void)
-{
-    QmiWdsStartNetworkInput *input;
-
-    input = g_slice_new0 (QmiWdsStartNetworkInput);
-    input->ref_count = 1;
-    return input;
-}
-
-/**
- * qmi_wds_start_network_input_ref:
- * @input: a #QmiWdsStartNetworkInput.
- *
- * Atomically increments the reference count of @input by one.
- *
- * Returns: the new reference to @input.
- */
-QmiWdsStartNetworkInput *
-qmi_wds_start_network_input_ref (QmiWdsStartNetworkInput *input)
-{
-    g_return_val_if_fail (input != NULL, NULL);
-
-    g_atomic_int_inc (&input->ref_count);
-    return input;
-}
-
-/**
- * qmi_wds_start_network_input_unref:
- * @input: a #QmiWdsStartNetworkInput.
- *
- * Atomically decrements the reference count of @input by one.
- * If the reference count drops to 0, @input is completely disposed.
- */
-void
-qmi_wds_start_network_input_unref (QmiWdsStartNetworkInput *input)
-{
-    g_return_if_fail (input != NULL);
-
-    if (g_atomic_int_dec_and_test (&input->ref_count)) {
-        g_free (input->apn);
-        g_free (input->username);
-        g_free (input->password);
-        g_slice_free (QmiWdsStartNetworkInput, input);
-    }
-}
-
-QmiMessage *
-qmi_message_wds_start_network_new (guint8 transaction_id,
-                                   guint8 client_id,
-                                   QmiWdsStartNetworkInput *input,
-                                   GError **error)
-{
-    QmiMessage *message;
-
-    message = qmi_message_new (QMI_SERVICE_WDS,
-                               client_id,
-                               transaction_id,
-                               QMI_WDS_MESSAGE_START_NETWORK);
-
-    /* If input arguments given, use them */
-    if (input) {
-        /* Add APN if any */
-        if (input->apn &&
-            !qmi_message_tlv_add (message,
-                                  QMI_WDS_TLV_START_NETWORK_APN,
-                                  strlen (input->apn) + 1,
-                                  input->apn,
-                                  error)) {
-            g_prefix_error (error, "Failed to add APN to message: ");
-            qmi_message_unref (message);
-            return NULL;
-        }
-
-        /* Add username if any */
-        if (input->username &&
-            !qmi_message_tlv_add (message,
-                                  QMI_WDS_TLV_START_NETWORK_USERNAME,
-                                  strlen (input->username) + 1,
-                                  input->username,
-                                  error)) {
-            g_prefix_error (error, "Failed to add username to message: ");
-            qmi_message_unref (message);
-            return NULL;
-        }
-
-        /* Add password if any */
-        if (input->password &&
-            !qmi_message_tlv_add (message,
-                                  QMI_WDS_TLV_START_NETWORK_PASSWORD,
-                                  strlen (input->password) + 1,
-                                  input->password,
-                                  error)) {
-            g_prefix_error (error, "Failed to add password to message: ");
-            qmi_message_unref (message);
-            return NULL;
-        }
-    }
-
-    return message;
-}
-
-enum {
-    START_NETWORK_OUTPUT_TLV_PACKET_DATA_HANDLE      = 0x01,
-    START_NETWORK_OUTPUT_TLV_CALL_END_REASON         = 0x10,
-    START_NETWORK_OUTPUT_TLV_VERBOSE_CALL_END_REASON = 0x11
-};
-
-/**
- * QmiWdsStartNetworkOutput:
- *
- * An opaque type handling the output of the Start Network operation.
- */
-struct _QmiWdsStartNetworkOutput {
-    volatile gint ref_count;
-    GError *error;
-
-    gboolean packet_data_handle_set;
-    guint32 packet_data_handle;
-
-    gboolean call_end_reason_set;
-    guint16 call_end_reason;
-
-    gboolean verbose_call_end_reason_set;
-    guint16 verbose_call_end_reason_domain;
-    guint16 verbose_call_end_reason_value;
-};
-
-/**
- * qmi_wds_start_network_output_get_result:
- * @output: a #QmiWdsStartNetworkOutput.
- * @error: a #GError.
- *
- * Get the result of the Start Network operation.
- *
- * Returns: #TRUE if the operation succeeded, and #FALSE if @error is set.
- */
-gboolean
-qmi_wds_start_network_output_get_result (QmiWdsStartNetworkOutput *output,
-                                         GError **error)
-{
-    g_return_val_if_fail (output != NULL, FALSE);
-
-    if (output->error) {
-        if (error)
-            *error = g_error_copy (output->error);
-
-        return FALSE;
-    }
-
-    return TRUE;
-}
-
 /**
  * qmi_wds_start_network_output_get_packet_data_handle:
  * @output: a #QmiWdsStartNetworkOutput.
@@ -368,149 +190,15 @@ qmi_wds_start_network_output_get_verbose_call_end_reason (QmiWdsStartNetworkOutp
     g_return_val_if_fail (output != NULL, FALSE);
 
     if (output->verbose_call_end_reason_set) {
-        *verbose_call_end_reason_domain = output->verbose_call_end_reason_domain;
-        *verbose_call_end_reason_value = output->verbose_call_end_reason_value;
+        *verbose_call_end_reason_domain = output->verbose_call_end_reason.domain;
+        *verbose_call_end_reason_value = output->verbose_call_end_reason.value;
     }
     return output->verbose_call_end_reason_set;
 }
 
-/**
- * qmi_wds_start_network_output_ref:
- * @output: a #QmiWdsStartNetworkOutput.
- *
- * Atomically increments the reference count of @output by one.
- *
- * Returns: the new reference to @output.
- */
-QmiWdsStartNetworkOutput *
-qmi_wds_start_network_output_ref (QmiWdsStartNetworkOutput *output)
-{
-    g_return_val_if_fail (output != NULL, NULL);
-
-    g_atomic_int_inc (&output->ref_count);
-    return output;
-}
-
-/**
- * qmi_wds_start_network_output_unref:
- * @output: a #QmiWdsStartNetworkOutput.
- *
- * Atomically decrements the reference count of @output by one.
- * If the reference count drops to 0, @output is completely disposed.
- */
-void
-qmi_wds_start_network_output_unref (QmiWdsStartNetworkOutput *output)
-{
-    g_return_if_fail (output != NULL);
-
-    if (g_atomic_int_dec_and_test (&output->ref_count)) {
-        if (output->error)
-            g_error_free (output->error);
-        g_slice_free (QmiWdsStartNetworkOutput, output);
-    }
-}
-
-QmiWdsStartNetworkOutput *
-qmi_message_wds_start_network_reply_parse (QmiMessage *self,
-                                           GError **error)
-{
-    QmiWdsStartNetworkOutput *output;
-    GError *inner_error = NULL;
-    guint32 packet_data_handle_le;
-
-    g_assert (qmi_message_get_message_id (self) == QMI_WDS_MESSAGE_START_NETWORK);
-
-    if (!qmi_message_get_response_result (self, &inner_error)) {
-        /* Only QMI protocol errors are set in the Output result, all the
-         * others (e.g. failures parsing) are directly propagated to error. */
-        if (inner_error->domain != QMI_PROTOCOL_ERROR) {
-            g_propagate_error (error, inner_error);
-            return NULL;
-        }
-
-        /* Otherwise, build output */
-    }
-
-    output = g_slice_new0 (QmiWdsStartNetworkOutput);
-    output->ref_count = 1;
-    output->error = inner_error;
-
-    /* On CALL_FAILED errors, we can try to get more info on the reason */
-    if (output->error) {
-        if (g_error_matches (output->error,
-                             QMI_PROTOCOL_ERROR,
-                             QMI_PROTOCOL_ERROR_CALL_FAILED)) {
-            guint16 cer = 0;
-            struct verbose_call_end_reason {
-                guint16 call_end_reason_domain;
-                guint16 call_end_reason_value;
-            } __attribute__((__packed__)) verbose_cer = { 0, 0 };
-
-            /* TODO: Prepare an enum with all the possible call end reasons,
-             * in order to do this nicely */
-
-            if (qmi_message_tlv_get (self,
-                                     START_NETWORK_OUTPUT_TLV_VERBOSE_CALL_END_REASON,
-                                     sizeof (verbose_cer),
-                                     &verbose_cer,
-                                     NULL)) {
-                output->verbose_call_end_reason_set = TRUE;
-                output->verbose_call_end_reason_domain = verbose_cer.call_end_reason_domain;
-                output->verbose_call_end_reason_value = verbose_cer.call_end_reason_value;
-            }
-
-            if (qmi_message_tlv_get (self,
-                                     START_NETWORK_OUTPUT_TLV_CALL_END_REASON,
-                                     sizeof (cer),
-                                     &cer,
-                                     NULL)) {
-                output->call_end_reason_set = TRUE;
-                output->call_end_reason = cer;
-            }
-        }
-
-        return output;
-    }
-
-    /* success */
-
-    packet_data_handle_le = 0;
-    if (!qmi_message_tlv_get (self,
-                              START_NETWORK_OUTPUT_TLV_PACKET_DATA_HANDLE,
-                              sizeof (packet_data_handle_le),
-                              &packet_data_handle_le,
-                              error)) {
-        g_prefix_error (error, "Couldn't get the packet data handle TLV: ");
-        qmi_wds_start_network_output_unref (output);
-        return NULL;
-    } else {
-        output->packet_data_handle = GUINT32_FROM_LE (packet_data_handle_le);
-        output->packet_data_handle_set = TRUE;
-    }
-
-    return output;
-}
-
 /*****************************************************************************/
 /* Stop network */
 
-enum {
-    STOP_NETWORK_INPUT_TLV_PACKET_DATA_HANDLE = 0x01
-};
-
-/**
- * QmiWdsStopNetworkInput:
- *
- * An opaque type handling the input arguments that may be passed to the Stop
- * Network operation in the WDS service.
- */
-struct _QmiWdsStopNetworkInput {
-    volatile gint ref_count;
-
-    gboolean packet_data_handle_set;
-    guint32 packet_data_handle;
-};
-
 /**
  * qmi_wds_stop_network_input_set_packet_data_handle:
  * @input: a #QmiWdsStopNetworkInput.
@@ -548,257 +236,9 @@ qmi_wds_stop_network_input_get_packet_data_handle (QmiWdsStopNetworkInput *input
     return input->packet_data_handle_set;
 }
 
-/**
- * qmi_wds_stop_network_input_new:
- *
- * Allocates a new #QmiWdsStopNetworkInput.
- *
- * Returns: the newly created #QmiWdsStopNetworkInput.
- */
-QmiWdsStopNetworkInput *
-qmi_wds_stop_network_input_new (void)
-{
-    QmiWdsStopNetworkInput *input;
-
-    input = g_slice_new0 (QmiWdsStopNetworkInput);
-    input->ref_count = 1;
-    return input;
-}
-
-/**
- * qmi_wds_stop_network_input_ref:
- * @input: a #QmiWdsStopNetworkInput.
- *
- * Atomically increments the reference count of @input by one.
- *
- * Returns: the new reference to @input.
- */
-QmiWdsStopNetworkInput *
-qmi_wds_stop_network_input_ref (QmiWdsStopNetworkInput *input)
-{
-    g_return_val_if_fail (input != NULL, NULL);
-
-    g_atomic_int_inc (&input->ref_count);
-    return input;
-}
-
-/**
- * qmi_wds_stop_network_input_unref:
- * @input: a #QmiWdsStopNetworkInput.
- *
- * Atomically decrements the reference count of @input by one.
- * If the reference count drops to 0, @input is completely disposed.
- */
-void
-qmi_wds_stop_network_input_unref (QmiWdsStopNetworkInput *input)
-{
-    g_return_if_fail (input != NULL);
-
-    if (g_atomic_int_dec_and_test (&input->ref_count)) {
-        g_slice_free (QmiWdsStopNetworkInput, input);
-    }
-}
-
-QmiMessage *
-qmi_message_wds_stop_network_new (guint8 transaction_id,
-                                  guint8 client_id,
-                                  QmiWdsStopNetworkInput *input,
-                                  GError **error)
-{
-    QmiMessage *message;
-    guint32 handle;
-
-    /* Check mandatory input arguments */
-    if (!input ||
-        !input->packet_data_handle_set) {
-        g_set_error (error,
-                     QMI_CORE_ERROR,
-                     QMI_CORE_ERROR_INVALID_ARGS,
-                     "Missing mandatory argument 'packet data handle'");
-        return NULL;
-    }
-
-    if (!input->packet_data_handle) {
-        g_set_error (error,
-                     QMI_CORE_ERROR,
-                     QMI_CORE_ERROR_INVALID_ARGS,
-                     "Invalid 'packet data handle': %u",
-                     (guint)input->packet_data_handle);
-        return NULL;
-    }
-
-    /* We want `handle' in LE; FROM_LE() can also be used as TO_LE() */
-    handle = GUINT32_FROM_LE (input->packet_data_handle);
-
-    message = qmi_message_new (QMI_SERVICE_WDS,
-                               client_id,
-                               transaction_id,
-                               QMI_WDS_MESSAGE_STOP_NETWORK);
-
-    if (!qmi_message_tlv_add (message,
-                              STOP_NETWORK_INPUT_TLV_PACKET_DATA_HANDLE,
-                              sizeof (handle),
-                              &handle,
-                              error)) {
-        g_prefix_error (error, "Failed to add packet data handle to message: ");
-        qmi_message_unref (message);
-        return NULL;
-    }
-
-    return message;
-}
-
-/**
- * QmiWdsStopNetworkOutput:
- *
- * An opaque type handling the output of the Stop Network operation.
- */
-struct _QmiWdsStopNetworkOutput {
-    volatile gint ref_count;
-    GError *error;
-};
-
-/**
- * qmi_wds_stop_network_output_get_result:
- * @output: a #QmiWdsStopNetworkOutput.
- * @error: a #GError.
- *
- * Get the result of the Stop Network operation.
- *
- * Returns: #TRUE if the operation succeeded, and #FALSE if @error is set.
- */
-gboolean
-qmi_wds_stop_network_output_get_result (QmiWdsStopNetworkOutput *output,
-                                         GError **error)
-{
-    g_return_val_if_fail (output != NULL, FALSE);
-
-    if (output->error) {
-        if (error)
-            *error = g_error_copy (output->error);
-
-        return FALSE;
-    }
-
-    return TRUE;
-}
-
-/**
- * qmi_wds_stop_network_output_ref:
- * @output: a #QmiWdsStopNetworkOutput.
- *
- * Atomically increments the reference count of @output by one.
- *
- * Returns: the new reference to @output.
- */
-QmiWdsStopNetworkOutput *
-qmi_wds_stop_network_output_ref (QmiWdsStopNetworkOutput *output)
-{
-    g_return_val_if_fail (output != NULL, NULL);
-
-    g_atomic_int_inc (&output->ref_count);
-    return output;
-}
-
-/**
- * qmi_wds_stop_network_output_unref:
- * @output: a #QmiWdsStopNetworkOutput.
- *
- * Atomically decrements the reference count of @output by one.
- * If the reference count drops to 0, @output is completely disposed.
- */
-void
-qmi_wds_stop_network_output_unref (QmiWdsStopNetworkOutput *output)
-{
-    g_return_if_fail (output != NULL);
-
-    if (g_atomic_int_dec_and_test (&output->ref_count)) {
-        if (output->error)
-            g_error_free (output->error);
-        g_slice_free (QmiWdsStopNetworkOutput, output);
-    }
-}
-
-QmiWdsStopNetworkOutput *
-qmi_message_wds_stop_network_reply_parse (QmiMessage *self,
-                                           GError **error)
-{
-    QmiWdsStopNetworkOutput *output;
-    GError *inner_error = NULL;
-
-    g_assert (qmi_message_get_message_id (self) == QMI_WDS_MESSAGE_STOP_NETWORK);
-
-    if (!qmi_message_get_response_result (self, &inner_error)) {
-        /* Only QMI protocol errors are set in the Output result, all the
-         * others (e.g. failures parsing) are directly propagated to error. */
-        if (inner_error->domain != QMI_PROTOCOL_ERROR) {
-            g_propagate_error (error, inner_error);
-            return NULL;
-        }
-
-        /* Otherwise, build output */
-    }
-
-    output = g_slice_new0 (QmiWdsStopNetworkOutput);
-    output->ref_count = 1;
-    output->error = inner_error;
-
-    return output;
-}
-
 /*****************************************************************************/
 /* Get packet service status */
 
-QmiMessage *
-qmi_message_wds_get_packet_service_status_new (guint8 transaction_id,
-                                               guint8 client_id)
-{
-    return qmi_message_new (QMI_SERVICE_WDS,
-                            client_id,
-                            transaction_id,
-                            QMI_WDS_MESSAGE_GET_PACKET_SERVICE_STATUS);
-}
-
-enum {
-    GET_PACKET_SERVICE_STATUS_OUTPUT_TLV_CONNECTION_STATUS = 0x01
-};
-
-/**
- * QmiWdsGetPacketServiceStatusOutput:
- *
- * An opaque type handling the output of the Stop Network operation.
- */
-struct _QmiWdsGetPacketServiceStatusOutput {
-    volatile gint ref_count;
-    GError *error;
-    guint8 connection_status;
-};
-
-/**
- * qmi_wds_get_packet_service_status_output_get_result:
- * @output: a #QmiWdsGetPacketServiceStatusOutput.
- * @error: a #GError.
- *
- * Get the result of the Get Packet Status operation.
- *
- * Returns: #TRUE if the operation succeeded, and #FALSE if @error is set.
- */
-gboolean
-qmi_wds_get_packet_service_status_output_get_result (QmiWdsGetPacketServiceStatusOutput *output,
-                                                     GError **error)
-{
-    g_return_val_if_fail (output != NULL, FALSE);
-
-    if (output->error) {
-        if (error)
-            *error = g_error_copy (output->error);
-
-        return FALSE;
-    }
-
-    return TRUE;
-}
-
 /**
  * qmi_wds_start_network_output_get_connection_status:
  * @output: a #QmiWdsGetPacketServiceStatusOutput.
@@ -815,140 +255,9 @@ qmi_wds_get_packet_service_status_output_get_connection_status (QmiWdsGetPacketS
     return (QmiWdsConnectionStatus)output->connection_status;
 }
 
-/**
- * qmi_wds_get_packet_service_status_output_ref:
- * @output: a #QmiWdsGetPacketServiceStatusOutput.
- *
- * Atomically increments the reference count of @output by one.
- *
- * Returns: the new reference to @output.
- */
-QmiWdsGetPacketServiceStatusOutput *
-qmi_wds_get_packet_service_status_output_ref (QmiWdsGetPacketServiceStatusOutput *output)
-{
-    g_return_val_if_fail (output != NULL, NULL);
-
-    g_atomic_int_inc (&output->ref_count);
-    return output;
-}
-
-/**
- * qmi_wds_get_packet_service_status_output_unref:
- * @output: a #QmiWdsGetPacketServiceStatusOutput.
- *
- * Atomically decrements the reference count of @output by one.
- * If the reference count drops to 0, @output is completely disposed.
- */
-void
-qmi_wds_get_packet_service_status_output_unref (QmiWdsGetPacketServiceStatusOutput *output)
-{
-    g_return_if_fail (output != NULL);
-
-    if (g_atomic_int_dec_and_test (&output->ref_count)) {
-        if (output->error)
-            g_error_free (output->error);
-        g_slice_free (QmiWdsGetPacketServiceStatusOutput, output);
-    }
-}
-
-QmiWdsGetPacketServiceStatusOutput *
-qmi_message_wds_get_packet_service_status_reply_parse (QmiMessage *self,
-                                                       GError **error)
-{
-    QmiWdsGetPacketServiceStatusOutput *output;
-    GError *inner_error = NULL;
-
-    g_assert (qmi_message_get_message_id (self) == QMI_WDS_MESSAGE_GET_PACKET_SERVICE_STATUS);
-
-    if (!qmi_message_get_response_result (self, &inner_error)) {
-        /* Only QMI protocol errors are set in the Output result, all the
-         * others (e.g. failures parsing) are directly propagated to error. */
-        if (inner_error->domain != QMI_PROTOCOL_ERROR) {
-            g_propagate_error (error, inner_error);
-            return NULL;
-        }
-
-        /* Otherwise, build output */
-    }
-
-    /* success */
-
-    output = g_slice_new0 (QmiWdsGetPacketServiceStatusOutput);
-    output->ref_count = 1;
-    output->error = inner_error;
-
-    /* If we got a QMI protocol error, no need to look for any TLV */
-    if (output->error)
-        return output;
-
-    if (!qmi_message_tlv_get (self,
-                              GET_PACKET_SERVICE_STATUS_OUTPUT_TLV_CONNECTION_STATUS,
-                              sizeof (output->connection_status),
-                              &output->connection_status,
-                              error)) {
-        g_prefix_error (error, "Couldn't get the connection status TLV: ");
-        qmi_wds_get_packet_service_status_output_unref (output);
-        return NULL;
-    }
-
-    return output;
-}
-
 /*****************************************************************************/
 /* Get data bearer technology */
 
-QmiMessage *
-qmi_message_wds_get_data_bearer_technology_new (guint8 transaction_id,
-                                                guint8 client_id)
-{
-    return qmi_message_new (QMI_SERVICE_WDS,
-                            client_id,
-                            transaction_id,
-                            QMI_WDS_MESSAGE_GET_DATA_BEARER_TECHNOLOGY);
-}
-
-enum {
-    GET_DATA_BEARER_TECHNOLOGY_OUTPUT_TLV_CURRENT = 0x01,
-    GET_DATA_BEARER_TECHNOLOGY_OUTPUT_TLV_LAST    = 0x10
-};
-
-/**
- * QmiWdsGetDataBearerTechnologyOutput:
- *
- * An opaque type handling the output of the Stop Network operation.
- */
-struct _QmiWdsGetDataBearerTechnologyOutput {
-    volatile gint ref_count;
-    GError *error;
-    gint8 current;
-    gint8 last;
-};
-
-/**
- * qmi_wds_get_data_bearer_technology_output_get_result:
- * @output: a #QmiWdsGetDataBearerTechnologyOutput.
- * @error: a #GError.
- *
- * Get the result of the Get Data Bearer Technology operation.
- *
- * Returns: #TRUE if the operation succeeded, and #FALSE if @error is set.
- */
-gboolean
-qmi_wds_get_data_bearer_technology_output_get_result (QmiWdsGetDataBearerTechnologyOutput *output,
-                                                      GError **error)
-{
-    g_return_val_if_fail (output != NULL, FALSE);
-
-    if (output->error) {
-        if (error)
-            *error = g_error_copy (output->error);
-
-        return FALSE;
-    }
-
-    return TRUE;
-}
-
 /**
  * qmi_wds_get_data_bearer_technology_output_get_current:
  * @output: a #QmiWdsGetDataBearerTechnologyOutput.
@@ -982,160 +291,9 @@ qmi_wds_get_data_bearer_technology_output_get_last (QmiWdsGetDataBearerTechnolog
     return (QmiWdsDataBearerTechnology)output->last;
 }
 
-/**
- * qmi_wds_get_data_bearer_technology_output_ref:
- * @output: a #QmiWdsGetDataBearerTechnologyOutput.
- *
- * Atomically increments the reference count of @output by one.
- *
- * Returns: the new reference to @output.
- */
-QmiWdsGetDataBearerTechnologyOutput *
-qmi_wds_get_data_bearer_technology_output_ref (QmiWdsGetDataBearerTechnologyOutput *output)
-{
-    g_return_val_if_fail (output != NULL, NULL);
-
-    g_atomic_int_inc (&output->ref_count);
-    return output;
-}
-
-/**
- * qmi_wds_get_data_bearer_technology_output_unref:
- * @output: a #QmiWdsGetDataBearerTechnologyOutput.
- *
- * Atomically decrements the reference count of @output by one.
- * If the reference count drops to 0, @output is completely disposed.
- */
-void
-qmi_wds_get_data_bearer_technology_output_unref (QmiWdsGetDataBearerTechnologyOutput *output)
-{
-    g_return_if_fail (output != NULL);
-
-    if (g_atomic_int_dec_and_test (&output->ref_count)) {
-        if (output->error)
-            g_error_free (output->error);
-        g_slice_free (QmiWdsGetDataBearerTechnologyOutput, output);
-    }
-}
-
-QmiWdsGetDataBearerTechnologyOutput *
-qmi_message_wds_get_data_bearer_technology_reply_parse (QmiMessage *self,
-                                                        GError **error)
-{
-    QmiWdsGetDataBearerTechnologyOutput *output;
-    GError *inner_error = NULL;
-
-    g_assert (qmi_message_get_message_id (self) == QMI_WDS_MESSAGE_GET_DATA_BEARER_TECHNOLOGY);
-
-    if (!qmi_message_get_response_result (self, &inner_error)) {
-        /* Only QMI protocol errors are set in the Output result, all the
-         * others (e.g. failures parsing) are directly propagated to error. */
-        if (inner_error->domain != QMI_PROTOCOL_ERROR) {
-            g_propagate_error (error, inner_error);
-            return NULL;
-        }
-
-        /* Otherwise, build output */
-    }
-
-    /* success */
-
-    output = g_slice_new0 (QmiWdsGetDataBearerTechnologyOutput);
-    output->ref_count = 1;
-    output->error = inner_error;
-    output->current = QMI_WDS_DATA_BEARER_TECHNOLOGY_UNKNOWN;
-    output->last = QMI_WDS_DATA_BEARER_TECHNOLOGY_UNKNOWN;
-
-    /* Handle QMI protocol errors */
-    if (output->error) {
-        if (g_error_matches (output->error,
-                             QMI_PROTOCOL_ERROR,
-                             QMI_PROTOCOL_ERROR_OUT_OF_CALL)) {
-            /* last will only appear if we get out-of-call errors */
-            qmi_message_tlv_get (self,
-                                 GET_DATA_BEARER_TECHNOLOGY_OUTPUT_TLV_LAST,
-                                 sizeof (output->last),
-                                 &output->last,
-                                 NULL);
-        }
-
-        return output;
-    }
-
-    if (!qmi_message_tlv_get (self,
-                              GET_DATA_BEARER_TECHNOLOGY_OUTPUT_TLV_CURRENT,
-                              sizeof (output->current),
-                              &output->current,
-                              error)) {
-        g_prefix_error (error, "Couldn't get the current technology TLV: ");
-        qmi_wds_get_data_bearer_technology_output_unref (output);
-        return NULL;
-    }
-
-    return output;
-}
-
 /*****************************************************************************/
 /* Get current data bearer technology */
 
-QmiMessage *
-qmi_message_wds_get_current_data_bearer_technology_new (guint8 transaction_id,
-                                                        guint8 client_id)
-{
-    return qmi_message_new (QMI_SERVICE_WDS,
-                            client_id,
-                            transaction_id,
-                            QMI_WDS_MESSAGE_GET_CURRENT_DATA_BEARER_TECHNOLOGY);
-}
-
-enum {
-    GET_CURRENT_DATA_BEARER_TECHNOLOGY_OUTPUT_TLV_CURRENT = 0x01,
-    GET_CURRENT_DATA_BEARER_TECHNOLOGY_OUTPUT_TLV_LAST    = 0x10
-};
-
-struct current_data_bearer_technology {
-    guint8 nw;
-    guint32 rat_mask;
-    guint32 so_mask;
-} __attribute__((__packed__));
-
-/**
- * QmiWdsGetCurrentDataBearerTechnologyOutput:
- *
- * An opaque type handling the output of the Get Current Data Bearer Technology operation.
- */
-struct _QmiWdsGetCurrentDataBearerTechnologyOutput {
-    volatile gint ref_count;
-    GError *error;
-    struct current_data_bearer_technology current;
-    struct current_data_bearer_technology last;
-};
-
-/**
- * qmi_wds_get_current_data_bearer_technology_output_get_result:
- * @output: a #QmiWdsGetCurrentDataBearerTechnologyOutput.
- * @error: a #GError.
- *
- * Get the result of the Get Current Data Bearer Technology operation.
- *
- * Returns: #TRUE if the operation succeeded, and #FALSE if @error is set.
- */
-gboolean
-qmi_wds_get_current_data_bearer_technology_output_get_result (QmiWdsGetCurrentDataBearerTechnologyOutput *output,
-                                                              GError **error)
-{
-    g_return_val_if_fail (output != NULL, FALSE);
-
-    if (output->error) {
-        if (error)
-            *error = g_error_copy (output->error);
-
-        return FALSE;
-    }
-
-    return TRUE;
-}
-
 /**
  * qmi_wds_get_current_data_bearer_technology_output_get_current_network_type:
  * @output: a #QmiWdsGetCurrentDataBearerTechnologyOutput.
@@ -1149,7 +307,7 @@ qmi_wds_get_current_data_bearer_technology_output_get_current_network_type (QmiW
 {
     g_return_val_if_fail (output != NULL, QMI_WDS_NETWORK_TYPE_UNKNOWN);
 
-    return (QmiWdsNetworkType)output->current.nw;
+    return (QmiWdsNetworkType)output->current.network_type;
 }
 
 /**
@@ -1164,7 +322,7 @@ QmiWdsRat3gpp2
 qmi_wds_get_current_data_bearer_technology_output_get_current_rat_3gpp2 (QmiWdsGetCurrentDataBearerTechnologyOutput *output)
 {
     g_return_val_if_fail (output != NULL, QMI_WDS_RAT_3GPP2_NONE);
-    g_return_val_if_fail (output->current.nw == QMI_WDS_NETWORK_TYPE_3GPP2, QMI_WDS_RAT_3GPP2_NONE);
+    g_return_val_if_fail (output->current.network_type == QMI_WDS_NETWORK_TYPE_3GPP2, QMI_WDS_RAT_3GPP2_NONE);
 
     return (QmiWdsRat3gpp2)output->current.rat_mask;
 }
@@ -1181,7 +339,7 @@ QmiWdsRat3gpp
 qmi_wds_get_current_data_bearer_technology_output_get_current_rat_3gpp (QmiWdsGetCurrentDataBearerTechnologyOutput *output)
 {
     g_return_val_if_fail (output != NULL, QMI_WDS_RAT_3GPP_NONE);
-    g_return_val_if_fail (output->current.nw == QMI_WDS_NETWORK_TYPE_3GPP, QMI_WDS_RAT_3GPP_NONE);
+    g_return_val_if_fail (output->current.network_type == QMI_WDS_NETWORK_TYPE_3GPP, QMI_WDS_RAT_3GPP_NONE);
 
     return (QmiWdsRat3gpp)output->current.rat_mask;
 }
@@ -1199,7 +357,7 @@ QmiWdsSoCdma1x
 qmi_wds_get_current_data_bearer_technology_output_get_current_so_cdma1x (QmiWdsGetCurrentDataBearerTechnologyOutput *output)
 {
     g_return_val_if_fail (output != NULL, QMI_WDS_SO_CDMA1X_NONE);
-    g_return_val_if_fail (output->current.nw == QMI_WDS_NETWORK_TYPE_3GPP2, QMI_WDS_SO_CDMA1X_NONE);
+    g_return_val_if_fail (output->current.network_type == QMI_WDS_NETWORK_TYPE_3GPP2, QMI_WDS_SO_CDMA1X_NONE);
     g_return_val_if_fail (output->current.rat_mask & QMI_WDS_RAT_3GPP2_CDMA1X, QMI_WDS_SO_CDMA1X_NONE);
 
     return (QmiWdsSoCdma1x)output->current.so_mask;
@@ -1218,7 +376,7 @@ QmiWdsSoEvdoRevA
 qmi_wds_get_current_data_bearer_technology_output_get_current_so_evdo_reva (QmiWdsGetCurrentDataBearerTechnologyOutput *output)
 {
     g_return_val_if_fail (output != NULL, QMI_WDS_SO_EVDO_REVA_NONE);
-    g_return_val_if_fail (output->current.nw == QMI_WDS_NETWORK_TYPE_3GPP2, QMI_WDS_SO_EVDO_REVA_NONE);
+    g_return_val_if_fail (output->current.network_type == QMI_WDS_NETWORK_TYPE_3GPP2, QMI_WDS_SO_EVDO_REVA_NONE);
     g_return_val_if_fail (output->current.rat_mask & QMI_WDS_RAT_3GPP2_EVDO_REVA, QMI_WDS_SO_EVDO_REVA_NONE);
 
     return (QmiWdsSoEvdoRevA)output->current.so_mask;
@@ -1238,7 +396,7 @@ qmi_wds_get_current_data_bearer_technology_output_get_last_network_type (QmiWdsG
 {
     g_return_val_if_fail (output != NULL, QMI_WDS_NETWORK_TYPE_UNKNOWN);
 
-    return (QmiWdsConnectionStatus)output->last.nw;
+    return (QmiWdsConnectionStatus)output->last.network_type;
 }
 
 /**
@@ -1254,7 +412,7 @@ QmiWdsRat3gpp2
 qmi_wds_get_current_data_bearer_technology_output_get_last_rat_3gpp2 (QmiWdsGetCurrentDataBearerTechnologyOutput *output)
 {
     g_return_val_if_fail (output != NULL, QMI_WDS_RAT_3GPP2_NONE);
-    g_return_val_if_fail (output->last.nw == QMI_WDS_NETWORK_TYPE_3GPP2, QMI_WDS_RAT_3GPP2_NONE);
+    g_return_val_if_fail (output->last.network_type == QMI_WDS_NETWORK_TYPE_3GPP2, QMI_WDS_RAT_3GPP2_NONE);
 
     return (QmiWdsRat3gpp2)output->last.rat_mask;
 }
@@ -1272,7 +430,7 @@ QmiWdsRat3gpp
 qmi_wds_get_current_data_bearer_technology_output_get_last_rat_3gpp (QmiWdsGetCurrentDataBearerTechnologyOutput *output)
 {
     g_return_val_if_fail (output != NULL, QMI_WDS_RAT_3GPP2_NONE);
-    g_return_val_if_fail (output->last.nw == QMI_WDS_NETWORK_TYPE_3GPP, QMI_WDS_RAT_3GPP_NONE);
+    g_return_val_if_fail (output->last.network_type == QMI_WDS_NETWORK_TYPE_3GPP, QMI_WDS_RAT_3GPP_NONE);
 
     return (QmiWdsRat3gpp)output->last.rat_mask;
 }
@@ -1291,7 +449,7 @@ QmiWdsSoCdma1x
 qmi_wds_get_current_data_bearer_technology_output_get_last_so_cdma1x (QmiWdsGetCurrentDataBearerTechnologyOutput *output)
 {
     g_return_val_if_fail (output != NULL, QMI_WDS_SO_CDMA1X_NONE);
-    g_return_val_if_fail (output->last.nw == QMI_WDS_NETWORK_TYPE_3GPP2, QMI_WDS_SO_CDMA1X_NONE);
+    g_return_val_if_fail (output->last.network_type == QMI_WDS_NETWORK_TYPE_3GPP2, QMI_WDS_SO_CDMA1X_NONE);
     g_return_val_if_fail (output->last.rat_mask & QMI_WDS_RAT_3GPP2_CDMA1X, QMI_WDS_SO_CDMA1X_NONE);
 
     return (QmiWdsSoCdma1x)output->last.so_mask;
@@ -1311,7 +469,7 @@ QmiWdsSoEvdoRevA
 qmi_wds_get_current_data_bearer_technology_output_get_last_so_evdo_reva (QmiWdsGetCurrentDataBearerTechnologyOutput *output)
 {
     g_return_val_if_fail (output != NULL, QMI_WDS_SO_EVDO_REVA_NONE);
-    g_return_val_if_fail (output->last.nw == QMI_WDS_NETWORK_TYPE_3GPP2, QMI_WDS_SO_EVDO_REVA_NONE);
+    g_return_val_if_fail (output->last.network_type == QMI_WDS_NETWORK_TYPE_3GPP2, QMI_WDS_SO_EVDO_REVA_NONE);
     g_return_val_if_fail (output->last.rat_mask & QMI_WDS_RAT_3GPP2_EVDO_REVA, QMI_WDS_SO_EVDO_REVA_NONE);
 
     return (QmiWdsSoEvdoRevA)output->last.so_mask;
@@ -1325,91 +483,4 @@ qmi_wds_get_current_data_bearer_technology_output_get_last_so_evdo_reva (QmiWdsG
  *
  * Returns: the new reference to @output.
  */
-QmiWdsGetCurrentDataBearerTechnologyOutput *
-qmi_wds_get_current_data_bearer_technology_output_ref (QmiWdsGetCurrentDataBearerTechnologyOutput *output)
-{
-    g_return_val_if_fail (output != NULL, NULL);
-
-    g_atomic_int_inc (&output->ref_count);
-    return output;
-}
 
-/**
- * qmi_wds_get_current_data_bearer_technology_output_unref:
- * @output: a #QmiWdsGetCurrentDataBearerTechnologyOutput.
- *
- * Atomically decrements the reference count of @output by one.
- * If the reference count drops to 0, @output is completely disposed.
- */
-void
-qmi_wds_get_current_data_bearer_technology_output_unref (QmiWdsGetCurrentDataBearerTechnologyOutput *output)
-{
-    g_return_if_fail (output != NULL);
-
-    if (g_atomic_int_dec_and_test (&output->ref_count)) {
-        if (output->error)
-            g_error_free (output->error);
-        g_slice_free (QmiWdsGetCurrentDataBearerTechnologyOutput, output);
-    }
-}
-
-QmiWdsGetCurrentDataBearerTechnologyOutput *
-qmi_message_wds_get_current_data_bearer_technology_reply_parse (QmiMessage *self,
-                                                                GError **error)
-{
-    QmiWdsGetCurrentDataBearerTechnologyOutput *output;
-    GError *inner_error = NULL;
-
-    g_assert (qmi_message_get_message_id (self) == QMI_WDS_MESSAGE_GET_CURRENT_DATA_BEARER_TECHNOLOGY);
-
-    if (!qmi_message_get_response_result (self, &inner_error)) {
-        /* Only QMI protocol errors are set in the Output result, all the
-         * others (e.g. failures parsing) are directly propagated to error. */
-        if (inner_error->domain != QMI_PROTOCOL_ERROR) {
-            g_propagate_error (error, inner_error);
-            return NULL;
-        }
-
-        /* Otherwise, build output */
-    }
-
-    /* success */
-
-    output = g_slice_new0 (QmiWdsGetCurrentDataBearerTechnologyOutput);
-    output->ref_count = 1;
-    output->error = inner_error;
-    output->current.nw = QMI_WDS_NETWORK_TYPE_UNKNOWN;
-    output->current.rat_mask = 0;
-    output->current.so_mask = 0;
-    output->last.nw = QMI_WDS_NETWORK_TYPE_UNKNOWN;
-    output->last.rat_mask = 0;
-    output->last.so_mask = 0;
-
-    /* Handle QMI protocol errors */
-    if (output->error) {
-        if (g_error_matches (output->error,
-                             QMI_PROTOCOL_ERROR,
-                             QMI_PROTOCOL_ERROR_OUT_OF_CALL)) {
-            /* last will only appear if we get out-of-call errors */
-            qmi_message_tlv_get (self,
-                                 GET_CURRENT_DATA_BEARER_TECHNOLOGY_OUTPUT_TLV_LAST,
-                                 sizeof (output->last),
-                                 &output->last,
-                                 NULL);
-        }
-
-        return output;
-    }
-
-    if (!qmi_message_tlv_get (self,
-                              GET_CURRENT_DATA_BEARER_TECHNOLOGY_OUTPUT_TLV_CURRENT,
-                              sizeof (output->current),
-                              &output->current,
-                              error)) {
-        g_prefix_error (error, "Couldn't get the current technology TLV: ");
-        qmi_wds_get_current_data_bearer_technology_output_unref (output);
-        return NULL;
-    }
-
-    return output;
-}
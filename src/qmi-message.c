@@ -34,6 +34,7 @@
 #include <endian.h>
 
 #include "qmi-message.h"
+#include "qmi-message-private.h"
 #include "qmi-utils.h"
 #include "qmi-enum-types.h"
 #include "qmi-error-types.h"
@@ -86,13 +87,278 @@ struct full_message {
     } qmi;
 } PACKED;
 
+/* Small inline TLV index; replies rarely carry more than a handful of TLVs,
+ * so a linear search over a few entries beats any lookup table. Offsets are
+ * used instead of pointers so that the index survives buffer reallocations. */
+#define TLV_INDEX_SIZE 16
+
+typedef struct {
+    guint8 type;
+    guint16 offset; /* from the start of the frame */
+} TlvIndexEntry;
+
+typedef enum {
+    TLV_INDEX_NONE,     /* not built yet */
+    TLV_INDEX_COMPLETE, /* holds every TLV type in the frame */
+    TLV_INDEX_OVERFLOW  /* too many TLVs, lookups scan the frame */
+} TlvIndexState;
+
 struct _QmiMessage {
-    /* TODO: avoid memory split here */
-    struct full_message *buf; /* buf allocated using g_malloc, not g_slice_alloc */
+    QmiMessageHeader header; /* must be first, see QMI_MESSAGE_HEADER() */
+    struct full_message *buf; /* points to data, unless the message outgrew it */
     gsize len; /* cached size of *buf; not part of message. */
+    gsize allocated; /* bytes available in *buf */
     volatile gint ref_count; /* the ref count */
+    gboolean borrowed; /* *buf is owned by someone else, see new_from_raw_borrowed() */
+    gboolean validated; /* set by a successful check, cleared on any change */
+    TlvIndexEntry tlv_index[TLV_INDEX_SIZE]; /* first TLVs of the frame, see tlv_index_build() */
+    guint8 n_tlv_index; /* entries in use in tlv_index */
+    TlvIndexState tlv_index_state; /* whether tlv_index can be trusted */
+    QmiMessagePool *pool; /* pool where the message goes back to, if any */
+    guint8 data[]; /* inline storage for the frame, same allocation as the struct */
 };
 
+/* Room reserved for TLVs when building a new message, so that the usual
+ * requests never need to move the frame out of the inline storage */
+#define MESSAGE_RESERVED_TLV_SIZE 128
+
+static void
+message_init (QmiMessage *self,
+              gsize allocated)
+{
+    self->ref_count = 1;
+    self->buf = (struct full_message *)self->data;
+    self->allocated = allocated;
+    self->len = 0;
+    self->borrowed = FALSE;
+    self->validated = FALSE;
+    self->n_tlv_index = 0;
+    self->tlv_index_state = TLV_INDEX_NONE;
+    self->pool = NULL;
+    memset (&self->header, 0, sizeof (self->header));
+}
+
+static QmiMessage *
+message_alloc (gsize allocated)
+{
+    QmiMessage *self;
+
+    /* Single allocation for both the message and its frame */
+    self = g_malloc (sizeof (QmiMessage) + allocated);
+    message_init (self, allocated);
+
+    return self;
+}
+
+/*****************************************************************************/
+/* Message pool */
+
+struct _QmiMessagePool {
+    volatile gint ref_count;
+    volatile gint lock; /* bit 0, see g_bit_lock() */
+    gsize block_size;   /* inline frame storage of every pooled message */
+    guint max_free;     /* cap on the number of free blocks kept around */
+    QmiMessage *free_list; /* chained through their 'buf' field */
+    guint n_free;
+    guint n_in_use;
+    guint high_water;   /* max n_in_use since the last trim */
+    guint n_releases;   /* releases since the last trim */
+    guint64 hits;
+    guint64 misses;
+};
+
+/* Every this many releases, free blocks not needed to cover the peak usage
+ * seen since the previous trim are given back */
+#define POOL_TRIM_INTERVAL 256
+
+QmiMessagePool *
+qmi_message_pool_new (gsize block_size,
+                      guint max_free)
+{
+    QmiMessagePool *pool;
+
+    pool = g_slice_new0 (QmiMessagePool);
+    pool->ref_count = 1;
+    pool->block_size = block_size;
+    pool->max_free = max_free;
+    return pool;
+}
+
+QmiMessagePool *
+qmi_message_pool_ref (QmiMessagePool *pool)
+{
+    g_assert (pool != NULL);
+
+    g_atomic_int_inc (&pool->ref_count);
+    return pool;
+}
+
+void
+qmi_message_pool_unref (QmiMessagePool *pool)
+{
+    g_assert (pool != NULL);
+
+    if (g_atomic_int_dec_and_test (&pool->ref_count)) {
+        /* No message is in use if we got here, as they all hold a ref */
+        while (pool->free_list) {
+            QmiMessage *block;
+
+            block = pool->free_list;
+            pool->free_list = (QmiMessage *)block->buf;
+            g_free (block);
+        }
+        g_slice_free (QmiMessagePool, pool);
+    }
+}
+
+void
+qmi_message_pool_get_stats (QmiMessagePool *pool,
+                            guint64 *hits,
+                            guint64 *misses,
+                            guint *n_free)
+{
+    g_assert (pool != NULL);
+
+    g_bit_lock (&pool->lock, 0);
+    if (hits)
+        *hits = pool->hits;
+    if (misses)
+        *misses = pool->misses;
+    if (n_free)
+        *n_free = pool->n_free;
+    g_bit_unlock (&pool->lock, 0);
+}
+
+/* Must be called with the pool locked */
+static void
+pool_trim (QmiMessagePool *pool)
+{
+    guint needed;
+
+    needed = pool->high_water - pool->n_in_use;
+    while (pool->n_free > needed) {
+        QmiMessage *block;
+
+        block = pool->free_list;
+        pool->free_list = (QmiMessage *)block->buf;
+        pool->n_free--;
+        g_free (block);
+    }
+
+    pool->high_water = pool->n_in_use;
+    pool->n_releases = 0;
+}
+
+static QmiMessage *
+message_alloc_pooled (QmiMessagePool *pool,
+                      gsize allocated)
+{
+    QmiMessage *self;
+
+    if (!pool)
+        return message_alloc (allocated);
+
+    /* Frames not fitting in a block are allocated as usual */
+    if (allocated > pool->block_size) {
+        g_bit_lock (&pool->lock, 0);
+        pool->misses++;
+        g_bit_unlock (&pool->lock, 0);
+        return message_alloc (allocated);
+    }
+
+    g_bit_lock (&pool->lock, 0);
+    self = pool->free_list;
+    if (self) {
+        pool->free_list = (QmiMessage *)self->buf;
+        pool->n_free--;
+        pool->hits++;
+    } else
+        pool->misses++;
+    pool->n_in_use++;
+    if (pool->n_in_use > pool->high_water)
+        pool->high_water = pool->n_in_use;
+    g_bit_unlock (&pool->lock, 0);
+
+    if (!self)
+        self = g_malloc (sizeof (QmiMessage) + pool->block_size);
+
+    message_init (self, pool->block_size);
+    self->pool = qmi_message_pool_ref (pool);
+
+    return self;
+}
+
+static void
+message_free_pooled (QmiMessage *self)
+{
+    QmiMessagePool *pool;
+
+    pool = self->pool;
+
+    g_bit_lock (&pool->lock, 0);
+    pool->n_in_use--;
+    if (pool->n_free < pool->max_free) {
+        self->buf = (struct full_message *)pool->free_list;
+        pool->free_list = self;
+        pool->n_free++;
+        self = NULL;
+    }
+    if (++pool->n_releases == POOL_TRIM_INTERVAL)
+        pool_trim (pool);
+    g_bit_unlock (&pool->lock, 0);
+
+    g_free (self);
+    qmi_message_pool_unref (pool);
+}
+
+static inline gboolean
+message_buf_is_inline (QmiMessage *self)
+{
+    return (gpointer)self->buf == (gpointer)self->data;
+}
+
+static inline gboolean
+message_buf_is_owned (QmiMessage *self)
+{
+    return !self->borrowed && !message_buf_is_inline (self);
+}
+
+/* Moves the frame to a new buffer of its own */
+static void
+message_buf_move (QmiMessage *self,
+                  gsize allocated)
+{
+    struct full_message *buf;
+
+    buf = g_malloc (allocated);
+    memcpy (buf, self->buf, self->len);
+    self->buf = buf;
+    self->allocated = allocated;
+    self->borrowed = FALSE;
+}
+
+static void
+message_reserve (QmiMessage *self,
+                 gsize needed)
+{
+    gsize allocated;
+
+    if (needed <= self->allocated)
+        return;
+
+    /* Grow geometrically */
+    allocated = MAX (needed, 2 * self->allocated);
+
+    /* The message itself may already be shared, so it cannot be moved; once
+     * the inline storage is exhausted the frame lives in its own buffer */
+    if (!message_buf_is_owned (self))
+        message_buf_move (self, allocated);
+    else {
+        self->buf = g_realloc (self->buf, allocated);
+        self->allocated = allocated;
+    }
+}
+
 static inline uint16_t
 qmux_length (QmiMessage *self)
 {
@@ -106,12 +372,50 @@ set_qmux_length (QmiMessage *self,
     self->buf->qmux.length = htole16 (length);
 }
 
+/* Fills in the cached header from the frame; fields not present in a
+ * truncated frame are left as 0, the check will reject it anyway */
+static void
+message_decode_header (QmiMessage *self)
+{
+    QmiMessageHeader *header = &self->header;
+
+    memset (header, 0, sizeof (*header));
+
+    if (self->len < 1 + sizeof (struct qmux))
+        return;
+
+    header->service = self->buf->qmux.service;
+    header->client_id = self->buf->qmux.client;
+    header->qmux_flags = self->buf->qmux.flags;
+
+    if (header->service == QMI_SERVICE_CTL) {
+        if (self->len < 1 + sizeof (struct qmux) + sizeof (struct control_header))
+            return;
+
+        header->qmi_flags = self->buf->qmi.control.header.flags;
+        /* note: only 1 byte for transaction in CTL message */
+        header->transaction_id = (guint16)self->buf->qmi.control.header.transaction;
+        header->message_id = le16toh (self->buf->qmi.control.header.message);
+        header->is_response = !!(header->qmi_flags & QMI_CTL_FLAG_RESPONSE);
+        header->is_indication = !!(header->qmi_flags & QMI_CTL_FLAG_INDICATION);
+    } else {
+        if (self->len < 1 + sizeof (struct qmux) + sizeof (struct service_header))
+            return;
+
+        header->qmi_flags = self->buf->qmi.service.header.flags;
+        header->transaction_id = le16toh (self->buf->qmi.service.header.transaction);
+        header->message_id = le16toh (self->buf->qmi.service.header.message);
+        header->is_response = !!(header->qmi_flags & QMI_SERVICE_FLAG_RESPONSE);
+        header->is_indication = !!(header->qmi_flags & QMI_SERVICE_FLAG_INDICATION);
+    }
+}
+
 gboolean
 qmi_message_is_control (QmiMessage *self)
 {
     g_return_val_if_fail (self != NULL, FALSE);
 
-    return self->buf->qmux.service == QMI_SERVICE_CTL;
+    return self->header.service == QMI_SERVICE_CTL;
 }
 
 guint8
@@ -119,7 +423,7 @@ qmi_message_get_qmux_flags (QmiMessage *self)
 {
     g_return_val_if_fail (self != NULL, 0);
 
-    return self->buf->qmux.flags;
+    return self->header.qmux_flags;
 }
 
 QmiService
@@ -127,7 +431,7 @@ qmi_message_get_service (QmiMessage *self)
 {
     g_return_val_if_fail (self != NULL, QMI_SERVICE_UNKNOWN);
 
-    return (QmiService)self->buf->qmux.service;
+    return (QmiService)self->header.service;
 }
 
 guint8
@@ -135,7 +439,7 @@ qmi_message_get_client_id (QmiMessage *self)
 {
     g_return_val_if_fail (self != NULL, 0);
 
-    return self->buf->qmux.client;
+    return self->header.client_id;
 }
 
 guint8
@@ -143,38 +447,19 @@ qmi_message_get_qmi_flags (QmiMessage *self)
 {
     g_return_val_if_fail (self != NULL, 0);
 
-    if (qmi_message_is_control (self))
-        return self->buf->qmi.control.header.flags;
-
-    return self->buf->qmi.service.header.flags;
+    return self->header.qmi_flags;
 }
 
 gboolean
 qmi_message_is_response (QmiMessage *self)
 {
-    if (qmi_message_is_control (self)) {
-        if (self->buf->qmi.control.header.flags & QMI_CTL_FLAG_RESPONSE)
-            return TRUE;
-    } else {
-        if (self->buf->qmi.service.header.flags & QMI_SERVICE_FLAG_RESPONSE)
-            return TRUE;
-    }
-
-    return FALSE;
+    return self->header.is_response;
 }
 
 gboolean
 qmi_message_is_indication (QmiMessage *self)
 {
-    if (qmi_message_is_control (self)) {
-        if (self->buf->qmi.control.header.flags & QMI_CTL_FLAG_INDICATION)
-            return TRUE;
-    } else {
-        if (self->buf->qmi.service.header.flags & QMI_SERVICE_FLAG_INDICATION)
-            return TRUE;
-    }
-
-    return FALSE;
+    return self->header.is_indication;
 }
 
 guint16
@@ -182,11 +467,7 @@ qmi_message_get_transaction_id (QmiMessage *self)
 {
     g_return_val_if_fail (self != NULL, 0);
 
-    if (qmi_message_is_control (self))
-        /* note: only 1 byte for transaction in CTL message */
-        return (guint16)self->buf->qmi.control.header.transaction;
-
-    return le16toh (self->buf->qmi.service.header.transaction);
+    return self->header.transaction_id;
 }
 
 guint16
@@ -194,10 +475,7 @@ qmi_message_get_message_id (QmiMessage *self)
 {
     g_return_val_if_fail (self != NULL, 0);
 
-    if (qmi_message_is_control (self))
-        return le16toh (self->buf->qmi.control.header.message);
-
-    return le16toh (self->buf->qmi.service.header.message);
+    return self->header.message_id;
 }
 
 gsize
@@ -279,8 +557,21 @@ qmi_tlv_next (QmiMessage *self,
  *    field are all consistent.
  * 3. The TLVs in the message fit exactly in the payload size.
  *
+ * The result is cached, so the full check is only run again after the
+ * message gets modified.
+ *
  * Returns non-zero if the message is valid, zero if invalid.
  */
+
+/* Number of checks skipped because the message was already validated */
+static volatile gint skipped_checks;
+
+guint
+qmi_message_get_skipped_checks (void)
+{
+    return (guint)g_atomic_int_get (&skipped_checks);
+}
+
 gboolean
 qmi_message_check (QmiMessage *self,
                    GError **error)
@@ -292,6 +583,11 @@ qmi_message_check (QmiMessage *self,
     g_assert (self != NULL);
     g_assert (self->buf != NULL);
 
+    if (self->validated) {
+        g_atomic_int_inc (&skipped_checks);
+        return TRUE;
+    }
+
     if (self->buf->marker != QMI_MESSAGE_QMUX_MARKER) {
         g_set_error (error,
                      QMI_CORE_ERROR,
@@ -370,30 +666,36 @@ qmi_message_check (QmiMessage *self,
      */
     g_assert (tlv == (struct tlv *)end);
 
+    self->validated = TRUE;
     return TRUE;
 }
 
-QmiMessage *
-qmi_message_new (QmiService service,
-                 guint8 client_id,
-                 guint16 transaction_id,
-                 guint16 message_id)
+static QmiMessage *
+message_new_sized (QmiMessagePool *pool,
+                   QmiService service,
+                   guint8 client_id,
+                   guint16 transaction_id,
+                   guint16 message_id,
+                   gsize tlv_size_hint)
 {
     QmiMessage *self;
+    gsize len;
 
     /* Transaction ID in the control service is 8bit only */
     g_assert (service != QMI_SERVICE_CTL ||
               transaction_id <= G_MAXUINT8);
 
-    self = g_slice_new (QmiMessage);
-    self->ref_count = 1;
+    len = 1 + sizeof (struct qmux) + (service == QMI_SERVICE_CTL ?
+                                      sizeof (struct control_header) :
+                                      sizeof (struct service_header));
 
-    self->len = 1 + sizeof (struct qmux) + (service == QMI_SERVICE_CTL ?
-                                            sizeof (struct control_header) :
-                                            sizeof (struct service_header));
+    self = message_alloc_pooled (pool, len + tlv_size_hint);
+    self->len = len;
 
-    /* TODO: Allocate both the message and the buffer together */
-    self->buf = g_malloc (self->len);
+    self->header.service = service;
+    self->header.client_id = client_id;
+    self->header.transaction_id = transaction_id;
+    self->header.message_id = message_id;
 
     self->buf->marker = QMI_MESSAGE_QMUX_MARKER;
     self->buf->qmux.flags = 0;
@@ -413,6 +715,38 @@ qmi_message_new (QmiService service,
 
     set_qmi_tlv_length (self, 0);
 
+    return self;
+}
+
+QmiMessage *
+qmi_message_new (QmiService service,
+                 guint8 client_id,
+                 guint16 transaction_id,
+                 guint16 message_id)
+{
+    return qmi_message_new_pooled (NULL,
+                                   service,
+                                   client_id,
+                                   transaction_id,
+                                   message_id);
+}
+
+QmiMessage *
+qmi_message_new_pooled (QmiMessagePool *pool,
+                        QmiService service,
+                        guint8 client_id,
+                        guint16 transaction_id,
+                        guint16 message_id)
+{
+    QmiMessage *self;
+
+    self = message_new_sized (pool,
+                              service,
+                              client_id,
+                              transaction_id,
+                              message_id,
+                              MESSAGE_RESERVED_TLV_SIZE);
+
     g_assert (qmi_message_check (self, NULL));
 
     return self;
@@ -433,8 +767,12 @@ qmi_message_unref (QmiMessage *self)
     g_assert (self != NULL);
 
     if (g_atomic_int_dec_and_test (&self->ref_count)) {
-        g_free (self->buf);
-        g_slice_free (QmiMessage, self);
+        if (message_buf_is_owned (self))
+            g_free (self->buf);
+        if (self->pool)
+            message_free_pooled (self);
+        else
+            g_free (self);
     }
 }
 
@@ -453,6 +791,74 @@ qmi_message_get_raw (QmiMessage *self,
     return self->buf;
 }
 
+/* Adds the TLV to the index unless its type is already there; returns
+ * FALSE if the index is full */
+static gboolean
+tlv_index_add (QmiMessage *self,
+               struct tlv *tlv)
+{
+    guint i;
+
+    for (i = 0; i < self->n_tlv_index; i++) {
+        if (self->tlv_index[i].type == tlv->type)
+            return TRUE;
+    }
+
+    if (self->n_tlv_index == TLV_INDEX_SIZE)
+        return FALSE;
+
+    self->tlv_index[self->n_tlv_index].type = tlv->type;
+    self->tlv_index[self->n_tlv_index].offset = (guint16)((guint8 *)tlv - (guint8 *)self->buf);
+    self->n_tlv_index++;
+    return TRUE;
+}
+
+static void
+tlv_index_build (QmiMessage *self)
+{
+    struct tlv *tlv;
+
+    self->n_tlv_index = 0;
+    self->tlv_index_state = TLV_INDEX_COMPLETE;
+    for (tlv = qmi_tlv_first (self); tlv; tlv = qmi_tlv_next (self, tlv)) {
+        /* Skip TLVs not fully contained in the frame */
+        if ((char *)tlv_next (tlv) > qmi_end (self))
+            break;
+        if (!tlv_index_add (self, tlv)) {
+            self->tlv_index_state = TLV_INDEX_OVERFLOW;
+            break;
+        }
+    }
+}
+
+static struct tlv *
+tlv_index_lookup (QmiMessage *self,
+                  guint8 type)
+{
+    struct tlv *tlv;
+    guint i;
+
+    if (G_UNLIKELY (self->tlv_index_state == TLV_INDEX_NONE))
+        tlv_index_build (self);
+
+    if (G_LIKELY (self->tlv_index_state == TLV_INDEX_COMPLETE)) {
+        for (i = 0; i < self->n_tlv_index; i++) {
+            if (self->tlv_index[i].type == type)
+                return (struct tlv *)((guint8 *)self->buf + self->tlv_index[i].offset);
+        }
+        return NULL;
+    }
+
+    /* Too many TLVs to index, just walk the frame */
+    for (tlv = qmi_tlv_first (self); tlv; tlv = qmi_tlv_next (self, tlv)) {
+        if ((char *)tlv_next (tlv) > qmi_end (self))
+            break;
+        if (tlv->type == type)
+            return tlv;
+    }
+    return NULL;
+}
+
 static gboolean
 qmimsg_tlv_get_internal (QmiMessage *self,
                          guint8 type,
@@ -468,31 +874,30 @@ qmimsg_tlv_get_internal (QmiMessage *self,
     g_assert (length != NULL);
     /* note: we allow querying only for the exact length */
 
-    for (tlv = qmi_tlv_first (self); tlv; tlv = qmi_tlv_next (self, tlv)) {
-        if (tlv->type == type) {
-            if (length_exact && (le16toh (tlv->length) != *length)) {
-                g_set_error (error,
-                             QMI_CORE_ERROR,
-                             QMI_CORE_ERROR_TLV_NOT_FOUND,
-                             "TLV found but wrong length (%u != %u)",
-                             tlv->length,
-                             *length);
-                return FALSE;
-            } else if (value && le16toh (tlv->length) > *length) {
-                g_set_error (error,
-                             QMI_CORE_ERROR,
-                             QMI_CORE_ERROR_TLV_TOO_LONG,
-                             "TLV found but too long (%u > %u)",
-                             le16toh (tlv->length),
-                             *length);
-                return FALSE;
-            }
-
-            *length = le16toh (tlv->length);
-            if (value)
-                memcpy (value, tlv->value, le16toh (tlv->length));
-            return TRUE;
+    tlv = tlv_index_lookup (self, type);
+    if (tlv) {
+        if (length_exact && (le16toh (tlv->length) != *length)) {
+            g_set_error (error,
+                         QMI_CORE_ERROR,
+                         QMI_CORE_ERROR_TLV_NOT_FOUND,
+                         "TLV found but wrong length (%u != %u)",
+                         tlv->length,
+                         *length);
+            return FALSE;
+        } else if (value && le16toh (tlv->length) > *length) {
+            g_set_error (error,
+                         QMI_CORE_ERROR,
+                         QMI_CORE_ERROR_TLV_TOO_LONG,
+                         "TLV found but too long (%u > %u)",
+                         le16toh (tlv->length),
+                         *length);
+            return FALSE;
         }
+
+        *length = le16toh (tlv->length);
+        if (value)
+            memcpy (value, tlv->value, le16toh (tlv->length));
+        return TRUE;
     }
 
     g_set_error (error,
@@ -527,22 +932,60 @@ qmi_message_tlv_get_string (QmiMessage *self,
                             guint8 type,
                             GError **error)
 {
-    uint16_t length;
-    gchar *value;
+    struct tlv *tlv;
 
-    /* Read length only first */
-    if (!qmi_message_tlv_get_varlen (self, type, &length, NULL, error))
-        return NULL;
+    g_assert (self != NULL);
 
-    /* Read exact length and value */
-    value = g_malloc (length + 1);
-    if (!qmi_message_tlv_get (self, type, length, value, error)) {
-        g_free (value);
+    /* Single lookup; the value is copied straight from the frame */
+    tlv = tlv_index_lookup (self, type);
+    if (!tlv) {
+        g_set_error (error,
+                     QMI_CORE_ERROR,
+                     QMI_CORE_ERROR_TLV_TOO_LONG,
+                     "TLV not found");
         return NULL;
     }
-    value[length] = '\0';
 
-    return value;
+    return g_strndup (tlv->value, le16toh (tlv->length));
+}
+
+gconstpointer
+qmi_message_tlv_peek (QmiMessage *self,
+                      guint8 type,
+                      gsize *length)
+{
+    struct tlv *tlv;
+
+    g_assert (self != NULL);
+    g_assert (length != NULL);
+
+    tlv = tlv_index_lookup (self, type);
+    if (!tlv)
+        return NULL;
+
+    *length = le16toh (tlv->length);
+    return tlv->value;
+}
+
+const gchar *
+qmi_message_tlv_peek_string (QmiMessage *self,
+                             guint8 type,
+                             gsize *length)
+{
+    const gchar *str;
+    gsize str_length;
+
+    str = qmi_message_tlv_peek (self, type, &str_length);
+    if (!str)
+        return NULL;
+
+    /* Some strings are sent with their trailing NUL byte; leave it out of
+     * the view */
+    while (str_length > 0 && str[str_length - 1] == '\0')
+        str_length--;
+
+    *length = str_length;
+    return str;
 }
 
 void
@@ -594,9 +1037,10 @@ qmi_message_tlv_add (QmiMessage *self,
         return FALSE;
     }
 
-    /* Resize buffer. */
+    /* Resize buffer, if needed. */
+    message_reserve (self, self->len + tlv_len);
     self->len += tlv_len;
-    self->buf = g_realloc (self->buf, self->len);
+    self->validated = FALSE;
 
     /* Fill in new TLV. */
     tlv = (struct tlv *)(qmi_end (self) - tlv_len);
@@ -605,6 +1049,10 @@ qmi_message_tlv_add (QmiMessage *self,
     if (value)
         memcpy (tlv->value, value, length);
 
+    /* Keep the index up to date, if already built */
+    if (self->tlv_index_state == TLV_INDEX_COMPLETE && !tlv_index_add (self, tlv))
+        self->tlv_index_state = TLV_INDEX_OVERFLOW;
+
     /* Update length fields. */
     set_qmux_length (self, (uint16_t)(qmux_length (self) + tlv_len));
     set_qmi_tlv_length (self, (uint16_t)(qmi_tlv_length(self) + tlv_len));
@@ -618,51 +1066,358 @@ qmi_message_tlv_add (QmiMessage *self,
     return TRUE;
 }
 
+/*****************************************************************************/
+/* Message builder */
+
+struct _QmiMessageBuilder {
+    QmiMessage *message; /* not shared with anyone until finished */
+    GError *error;
+};
+
+QmiMessageBuilder *
+qmi_message_builder_new (QmiService service,
+                         guint8 client_id,
+                         guint16 transaction_id,
+                         guint16 message_id,
+                         gsize size_hint)
+{
+    QmiMessageBuilder *self;
+
+    self = g_slice_new (QmiMessageBuilder);
+    self->error = NULL;
+    /* Never pooled, as the builder may reallocate the whole message */
+    self->message = message_new_sized (NULL,
+                                       service,
+                                       client_id,
+                                       transaction_id,
+                                       message_id,
+                                       size_hint);
+    return self;
+}
+
+static gboolean
+builder_add (QmiMessageBuilder *self,
+             guint8 type,
+             gsize length,
+             gconstpointer value)
+{
+    QmiMessage *message;
+    struct tlv *tlv;
+    gsize tlv_len;
+
+    g_assert (self != NULL);
+    g_assert ((length == 0) || value != NULL);
+
+    /* Once failed, keep the first error until finish() */
+    if (self->error)
+        return FALSE;
+
+    message = self->message;
+    tlv_len = sizeof (struct tlv) + length;
+
+    /* Check for overflow of message size. */
+    if (message->len - 1 + tlv_len > UINT16_MAX) {
+        g_set_error (&self->error,
+                     QMI_CORE_ERROR,
+                     QMI_CORE_ERROR_TLV_TOO_LONG,
+                     "TLV 0x%02x to add is too long",
+                     type);
+        return FALSE;
+    }
+
+    /* The message is not shared yet, so it can be moved around; grow it
+     * geometrically, keeping the frame inline */
+    if (message->len + tlv_len > message->allocated) {
+        gsize allocated;
+
+        g_assert (message_buf_is_inline (message));
+        allocated = MAX (message->len + tlv_len, 2 * message->allocated);
+        message = g_realloc (message, sizeof (QmiMessage) + allocated);
+        message->buf = (struct full_message *)message->data;
+        message->allocated = allocated;
+        self->message = message;
+    }
+
+    tlv = (struct tlv *)((guint8 *)message->buf + message->len);
+    tlv->type = type;
+    tlv->length = htole16 (length);
+    if (length)
+        memcpy (tlv->value, value, length);
+    message->len += tlv_len;
+
+    return TRUE;
+}
+
+gboolean
+qmi_message_builder_add_u8 (QmiMessageBuilder *self,
+                            guint8 type,
+                            guint8 value)
+{
+    return builder_add (self, type, sizeof (value), &value);
+}
+
+gboolean
+qmi_message_builder_add_u16 (QmiMessageBuilder *self,
+                             guint8 type,
+                             guint16 value)
+{
+    guint16 value_le;
+
+    value_le = htole16 (value);
+    return builder_add (self, type, sizeof (value_le), &value_le);
+}
+
+gboolean
+qmi_message_builder_add_u32 (QmiMessageBuilder *self,
+                             guint8 type,
+                             guint32 value)
+{
+    guint32 value_le;
+
+    value_le = htole32 (value);
+    return builder_add (self, type, sizeof (value_le), &value_le);
+}
+
+gboolean
+qmi_message_builder_add_string (QmiMessageBuilder *self,
+                                guint8 type,
+                                const gchar *value)
+{
+    g_assert (value != NULL);
+
+    /* Note: no trailing NUL byte */
+    return builder_add (self, type, strlen (value), value);
+}
+
+gboolean
+qmi_message_builder_add_raw (QmiMessageBuilder *self,
+                             guint8 type,
+                             gconstpointer value,
+                             gsize length)
+{
+    return builder_add (self, type, length, value);
+}
+
+/**
+ * Finishes building the message, updating the length fields and validating
+ * the result once. The builder is always disposed.
+ *
+ * Returns the new message, or NULL if any of the additions failed or if the
+ * result is invalid.
+ */
 QmiMessage *
-qmi_message_new_from_raw (const guint8 *raw,
-                          gsize raw_len)
+qmi_message_builder_finish (QmiMessageBuilder *self,
+                            GError **error)
+{
+    QmiMessage *message;
+
+    g_assert (self != NULL);
+
+    message = self->message;
+
+    if (self->error) {
+        g_propagate_error (error, self->error);
+        qmi_message_unref (message);
+        g_slice_free (QmiMessageBuilder, self);
+        return NULL;
+    }
+    g_slice_free (QmiMessageBuilder, self);
+
+    /* Update length fields, now that all TLVs are in */
+    set_qmi_tlv_length (message, (uint16_t)(qmi_end (message) - (char *)qmi_tlv (message)));
+    set_qmux_length (message, (uint16_t)(message->len - 1));
+
+    if (!qmi_message_check (message, error)) {
+        g_prefix_error (error, "Invalid QMI message built: ");
+        qmi_message_unref (message);
+        return NULL;
+    }
+
+    return message;
+}
+
+static gsize
+raw_message_length (const guint8 *raw,
+                    gsize raw_len)
 {
-    QmiMessage *self;
     gsize message_len;
 
     /* If we didn't even read the header, leave */
     if (raw_len < (sizeof (struct qmux) + 1))
-        return NULL;
+        return 0;
+
+    /* We need to have read the length reported by the header, plus the
+     * marker. Otherwise, return. */
+    message_len = le16toh (((struct full_message *)raw)->qmux.length) + 1;
+    if (raw_len < message_len)
+        return 0;
+
+    return message_len;
+}
+
+gboolean
+qmi_message_raw_is_plausible (const guint8 *raw,
+                              gsize raw_len)
+{
+    const struct full_message *buf = (const struct full_message *)raw;
+    gsize header_length;
+    guint16 length;
+
+    if (raw_len < 1 || buf->marker != QMI_MESSAGE_QMUX_MARKER)
+        return FALSE;
+
+    /* Can't tell yet */
+    if (raw_len < 1 + sizeof (struct qmux))
+        return TRUE;
+
+    /* Only the 'sent by service' bit may be set in the QMUX flags */
+    if (buf->qmux.flags & 0x7F)
+        return FALSE;
+
+    header_length = sizeof (struct qmux) + (buf->qmux.service == QMI_SERVICE_CTL ?
+                                            sizeof (struct control_header) :
+                                            sizeof (struct service_header));
+    length = le16toh (buf->qmux.length);
+    if (length < header_length)
+        return FALSE;
+
+    if (raw_len < 1 + header_length)
+        return TRUE;
+
+    /* The QMI header must agree with the QMUX one on the TLV length */
+    return (length - header_length) == (buf->qmux.service == QMI_SERVICE_CTL ?
+                                        le16toh (buf->qmi.control.header.tlv_length) :
+                                        le16toh (buf->qmi.service.header.tlv_length));
+}
+
+QmiMessage *
+qmi_message_new_from_raw (const guint8 *raw,
+                          gsize raw_len)
+{
+    return qmi_message_new_from_raw_pooled (NULL, raw, raw_len);
+}
 
-    /* We need to have read the length reported by the header.
-     * Otherwise, return. */
-    message_len = le16toh (((struct full_message *)raw)->qmux.length);
-    if (raw_len < (message_len - 1))
+QmiMessage *
+qmi_message_new_from_raw_pooled (QmiMessagePool *pool,
+                                 const guint8 *raw,
+                                 gsize raw_len)
+{
+    QmiMessage *self;
+    gsize message_len;
+
+    message_len = raw_message_length (raw, raw_len);
+    if (!message_len)
         return NULL;
 
     /* Ok, so we should have all the data available already */
-    self = g_slice_new (QmiMessage);
-    self->ref_count = 1;
-    self->len = message_len + 1;
-    self->buf = g_malloc (self->len);
+    self = message_alloc_pooled (pool, message_len);
+    self->len = message_len;
     memcpy (self->buf, raw, self->len);
+    message_decode_header (self);
+
+    /* NOTE: we don't check if the message is valid here, let the caller do it */
+
+    return self;
+}
+
+/**
+ * Creates a message which uses the frame in @raw in place, without copying
+ * it. @raw must stay valid and unmodified until the message is given back
+ * with qmi_message_release_borrowed(); any other reference taken meanwhile
+ * gets its own copy of the frame at that point, or earlier with
+ * qmi_message_detach_borrowed(). If @pool is given, the
+ * message is taken from it, and such a copy is kept in the pooled block
+ * whenever it fits.
+ */
+QmiMessage *
+qmi_message_new_from_raw_borrowed (QmiMessagePool *pool,
+                                   const guint8 *raw,
+                                   gsize raw_len)
+{
+    QmiMessage *self;
+    gsize message_len;
+
+    message_len = raw_message_length (raw, raw_len);
+    if (!message_len)
+        return NULL;
+
+    self = message_alloc_pooled (pool, 0);
+    self->buf = (struct full_message *)raw;
+    self->allocated = message_len;
+    self->len = message_len;
+    self->borrowed = TRUE;
+    message_decode_header (self);
 
     /* NOTE: we don't check if the message is valid here, let the caller do it */
 
     return self;
 }
 
+/**
+ * Gives a borrowed message its own copy of the frame, so that it no longer
+ * depends on the borrowed buffer. Must be called before a reference to the
+ * message is handed over to another thread, as the message cannot be safely
+ * modified anymore once that happens. Does nothing if the frame was already
+ * copied.
+ */
+void
+qmi_message_detach_borrowed (QmiMessage *self)
+{
+    g_assert (self != NULL);
+
+    if (!self->borrowed)
+        return;
+
+    if (self->pool && self->len <= self->pool->block_size) {
+        memcpy (self->data, self->buf, self->len);
+        self->buf = (struct full_message *)self->data;
+        self->allocated = self->pool->block_size;
+        self->borrowed = FALSE;
+    } else
+        message_buf_move (self, self->len);
+}
+
+void
+qmi_message_release_borrowed (QmiMessage *self)
+{
+    g_assert (self != NULL);
+
+    /* Someone kept a reference; give the message its own copy of the frame
+     * before the borrowed buffer goes away, unless that was already done */
+    if (g_atomic_int_get (&self->ref_count) > 1)
+        qmi_message_detach_borrowed (self);
+
+    qmi_message_unref (self);
+}
+
 gchar *
 qmi_message_get_printable (QmiMessage *self,
                            const gchar *line_prefix)
 {
     GString *printable;
+
+    if (!qmi_message_check (self, NULL))
+        return NULL;
+
+    printable = g_string_new ("");
+    qmi_message_append_printable (self, printable, line_prefix);
+    return g_string_free (printable, FALSE);
+}
+
+void
+qmi_message_append_printable (QmiMessage *self,
+                              GString *printable,
+                              const gchar *line_prefix)
+{
     gchar *qmi_flags_str;
     const gchar *qmi_message_str;
     struct tlv *tlv;
 
     if (!qmi_message_check (self, NULL))
-        return NULL;
+        return;
 
     if (!line_prefix)
         line_prefix = "";
-
-    printable = g_string_new ("");
     g_string_append_printf (printable,
                             "%sQMUX:\n"
                             "%s  length  = %u (0x%04x)\n"
@@ -708,23 +1463,25 @@ qmi_message_get_printable (QmiMessage *self,
                             line_prefix, qmi_tlv_length (self), qmi_tlv_length (self));
     g_free (qmi_flags_str);
 
+    /* No allocations per TLV: numbers are formatted in the stack, and the
+     * value is hex-encoded straight into the output string */
     for (tlv = qmi_tlv_first (self); tlv; tlv = qmi_tlv_next (self, tlv)) {
-        gchar *value_hex;
-
-        value_hex = qmi_utils_str_hex (tlv->value, le16toh (tlv->length), ':');
-        g_string_append_printf (printable,
-                                "%sTLV:\n"
-                                "%s  type   = 0x%02x\n"
-                                "%s  length = %u (0x%04x)\n"
-                                "%s  value  = %s\n",
-                                line_prefix,
-                                line_prefix, tlv->type,
-                                line_prefix, le16toh (tlv->length), le16toh (tlv->length),
-                                line_prefix, value_hex);
-        g_free (value_hex);
+        gchar line[64];
+
+        g_string_append (printable, line_prefix);
+        g_string_append (printable, "TLV:\n");
+        g_string_append (printable, line_prefix);
+        g_snprintf (line, sizeof (line), "  type   = 0x%02x\n", tlv->type);
+        g_string_append (printable, line);
+        g_string_append (printable, line_prefix);
+        g_snprintf (line, sizeof (line), "  length = %u (0x%04x)\n",
+                    le16toh (tlv->length), le16toh (tlv->length));
+        g_string_append (printable, line);
+        g_string_append (printable, line_prefix);
+        g_string_append (printable, "  value  = ");
+        qmi_utils_str_hex_append (printable, tlv->value, le16toh (tlv->length), ':');
+        g_string_append_c (printable, '\n');
     }
-
-    return g_string_free (printable, FALSE);
 }
 
 /*****************************************************************************/
@@ -769,7 +1526,22 @@ qmi_message_get_response_result (QmiMessage *self,
         return FALSE;
     }
 
-    switch (le16toh (msg_result.status)) {
+    return qmi_message_check_result_code (le16toh (msg_result.status),
+                                          le16toh (msg_result.error),
+                                          error);
+}
+
+/**
+ * Checks the status and error fields of an already parsed result code TLV.
+ *
+ * Returns TRUE if the operation succeeded, FALSE if @error is set.
+ */
+gboolean
+qmi_message_check_result_code (guint16 status,
+                               guint16 error_code,
+                               GError **error)
+{
+    switch (status) {
     case QMI_STATUS_SUCCESS:
         /* Operation succeeded */
         return TRUE;
@@ -778,10 +1550,10 @@ qmi_message_get_response_result (QmiMessage *self,
         /* Report a QMI protocol error */
         g_set_error (error,
                      QMI_PROTOCOL_ERROR,
-                     (QmiProtocolError)le16toh (msg_result.error),
+                     (QmiProtocolError)error_code,
                      "QMI protocol error (%u): '%s'",
-                     (guint) le16toh (msg_result.error),
-                     qmi_protocol_error_get_string ((QmiProtocolError) le16toh (msg_result.error)));
+                     (guint) error_code,
+                     qmi_protocol_error_get_string ((QmiProtocolError) error_code));
         return FALSE;
 
     default:
@@ -789,7 +1561,7 @@ qmi_message_get_response_result (QmiMessage *self,
                      QMI_CORE_ERROR,
                      QMI_CORE_ERROR_INVALID_MESSAGE,
                      "Unexpected result status (%u)",
-                     (guint) le16toh (msg_result.status));
+                     (guint) status);
         return FALSE;
     }
 }
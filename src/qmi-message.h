@@ -39,12 +39,44 @@ G_BEGIN_DECLS
 #define QMI_MESSAGE_QMUX_MARKER (guint8)0x01
 typedef struct _QmiMessage QmiMessage;
 
-QmiMessage *qmi_message_new          (QmiService service,
-                                      guint8 client_id,
-                                      guint16 transaction_id,
-                                      guint16 message_id);
-QmiMessage *qmi_message_new_from_raw (const guint8 *raw,
-                                      gsize raw_len);
+/* Free-list of fixed-size message blocks, to be shared by the messages of a
+ * single device */
+typedef struct _QmiMessagePool QmiMessagePool;
+
+QmiMessagePool *qmi_message_pool_new       (gsize block_size,
+                                            guint max_free);
+QmiMessagePool *qmi_message_pool_ref       (QmiMessagePool *pool);
+void            qmi_message_pool_unref     (QmiMessagePool *pool);
+void            qmi_message_pool_get_stats (QmiMessagePool *pool,
+                                            guint64 *hits,
+                                            guint64 *misses,
+                                            guint *n_free);
+
+QmiMessage *qmi_message_new                   (QmiService service,
+                                               guint8 client_id,
+                                               guint16 transaction_id,
+                                               guint16 message_id);
+QmiMessage *qmi_message_new_pooled            (QmiMessagePool *pool,
+                                               QmiService service,
+                                               guint8 client_id,
+                                               guint16 transaction_id,
+                                               guint16 message_id);
+QmiMessage *qmi_message_new_from_raw          (const guint8 *raw,
+                                               gsize raw_len);
+QmiMessage *qmi_message_new_from_raw_pooled   (QmiMessagePool *pool,
+                                               const guint8 *raw,
+                                               gsize raw_len);
+QmiMessage *qmi_message_new_from_raw_borrowed (QmiMessagePool *pool,
+                                               const guint8 *raw,
+                                               gsize raw_len);
+void        qmi_message_detach_borrowed       (QmiMessage *self);
+void        qmi_message_release_borrowed      (QmiMessage *self);
+
+/* Whether raw data may be the start of a QMUX frame; TRUE as well if there
+ * isn't enough data yet to tell */
+gboolean    qmi_message_raw_is_plausible      (const guint8 *raw,
+                                               gsize raw_len);
+
 QmiMessage *qmi_message_ref          (QmiMessage *self);
 void qmi_message_unref               (QmiMessage *self);
 
@@ -70,6 +102,14 @@ gchar   *qmi_message_tlv_get_string (QmiMessage *self,
                                      guint8 type,
                                      GError **error);
 
+/* Zero-copy access; returned data is valid while a reference to the message
+ * is held, and strings are not NUL-terminated */
+gconstpointer qmi_message_tlv_peek        (QmiMessage *self,
+                                           guint8 type,
+                                           gsize *length);
+const gchar  *qmi_message_tlv_peek_string (QmiMessage *self,
+                                           guint8 type,
+                                           gsize *length);
 
 gboolean qmi_message_tlv_add (QmiMessage *self,
                               guint8 type,
@@ -77,6 +117,33 @@ gboolean qmi_message_tlv_add (QmiMessage *self,
                               gconstpointer value,
                               GError **error);
 
+/* Builder, to create new messages with several TLVs */
+typedef struct _QmiMessageBuilder QmiMessageBuilder;
+
+QmiMessageBuilder *qmi_message_builder_new        (QmiService service,
+                                                   guint8 client_id,
+                                                   guint16 transaction_id,
+                                                   guint16 message_id,
+                                                   gsize size_hint);
+gboolean           qmi_message_builder_add_u8     (QmiMessageBuilder *self,
+                                                   guint8 type,
+                                                   guint8 value);
+gboolean           qmi_message_builder_add_u16    (QmiMessageBuilder *self,
+                                                   guint8 type,
+                                                   guint16 value);
+gboolean           qmi_message_builder_add_u32    (QmiMessageBuilder *self,
+                                                   guint8 type,
+                                                   guint32 value);
+gboolean           qmi_message_builder_add_string (QmiMessageBuilder *self,
+                                                   guint8 type,
+                                                   const gchar *value);
+gboolean           qmi_message_builder_add_raw    (QmiMessageBuilder *self,
+                                                   guint8 type,
+                                                   gconstpointer value,
+                                                   gsize length);
+QmiMessage        *qmi_message_builder_finish     (QmiMessageBuilder *self,
+                                                   GError **error);
+
 gconstpointer qmi_message_get_raw (QmiMessage *self,
                                    gsize *length,
                                    GError **error);
@@ -85,9 +152,13 @@ gsize qmi_message_get_length (QmiMessage *self);
 
 gchar *qmi_message_get_printable (QmiMessage *self,
                                   const gchar *line_prefix);
+void   qmi_message_append_printable (QmiMessage *self,
+                                     GString *printable,
+                                     const gchar *line_prefix);
 
 gboolean qmi_message_check (QmiMessage *self,
                             GError **error);
+guint    qmi_message_get_skipped_checks (void);
 
 gboolean qmi_message_is_control    (QmiMessage *self);
 gboolean qmi_message_is_response   (QmiMessage *self);
@@ -95,6 +166,9 @@ gboolean qmi_message_is_indication (QmiMessage *self);
 
 gboolean qmi_message_get_response_result (QmiMessage *self,
                                           GError **error);
+gboolean qmi_message_check_result_code   (guint16 status,
+                                          guint16 error_code,
+                                          GError **error);
 
 guint16    qmi_message_get_message_id     (QmiMessage *self);
 QmiService qmi_message_get_service        (QmiMessage *self);
@@ -23,19 +23,34 @@
 
 #include <string.h>
 #include <stdint.h>
-#include <stdio.h>
 
 #include "qmi-utils.h"
 
+static const gchar hex_digits[] = "0123456789ABCDEF";
+
+/* Writes the hex representation of 'size' bytes (3 * size - 1 chars) */
+static void
+str_hex_write (gchar *out,
+               const guint8 *data,
+               gsize size,
+               gchar delimiter)
+{
+	gsize i;
+
+	for (i = 0; i < size; i++) {
+		*out++ = hex_digits[data[i] >> 4];
+		*out++ = hex_digits[data[i] & 0x0F];
+		/* And if needed, add separator */
+		if (i != (size - 1))
+			*out++ = delimiter;
+	}
+}
+
 gchar *
 qmi_utils_str_hex (gpointer mem,
                    gsize    size,
                    gchar    delimiter)
 {
-    const guint8 *data = mem;
-	gsize i;
-	gsize j;
-	gsize new_str_length;
 	gchar *new_str;
 
 	/* Get new string length. If input string has N bytes, we need:
@@ -43,20 +58,26 @@ qmi_utils_str_hex (gpointer mem,
 	 * - 2N bytes for hexadecimal char representation of each byte...
 	 * - N-1 bytes for the separator ':'
 	 * So... a total of (1+2N+N-1) = 3N bytes are needed... */
-	new_str_length =  3 * size;
-
-	/* Allocate memory for new array and initialize contents to NUL */
-	new_str = g_malloc0 (new_str_length);
-
-	/* Print hexadecimal representation of each byte... */
-	for (i = 0, j = 0; i < size; i++, j += 3) {
-		/* Print character in output string... */
-		snprintf (&new_str[j], 3, "%02X", data[i]);
-		/* And if needed, add separator */
-		if (i != (size - 1) )
-			new_str[j + 2] = delimiter;
-	}
+	new_str = g_malloc0 (3 * size);
+	str_hex_write (new_str, mem, size, delimiter);
 
 	/* Set output string */
 	return new_str;
 }
+
+void
+qmi_utils_str_hex_append (GString       *out,
+                          gconstpointer  mem,
+                          gsize          size,
+                          gchar          delimiter)
+{
+	gsize start;
+
+	if (!size)
+		return;
+
+	/* Grow the string once, and write in place */
+	start = out->len;
+	g_string_set_size (out, start + 3 * size - 1);
+	str_hex_write (&out->str[start], mem, size, delimiter);
+}
@@ -30,9 +30,21 @@
 
 G_BEGIN_DECLS
 
-gchar *qmi_utils_str_hex (gpointer mem,
-                          gsize    size,
-                          gchar    delimiter);
+gchar *qmi_utils_str_hex        (gpointer       mem,
+                                 gsize          size,
+                                 gchar          delimiter);
+void   qmi_utils_str_hex_append (GString       *out,
+                                 gconstpointer  mem,
+                                 gsize          size,
+                                 gchar          delimiter);
+
+/* Converts a timeout in seconds to milliseconds, saturating instead of
+ * wrapping around for huge values */
+static inline guint
+qmi_utils_timeout_to_ms (guint timeout)
+{
+    return MIN (timeout, G_MAXUINT / 1000) * 1000;
+}
 
 G_END_DECLS
 
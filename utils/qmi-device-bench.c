@@ -0,0 +1,652 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * qmi-device-bench -- Benchmark QMI devices against fake modems
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <libqmi-glib.h>
+
+#define PROGRAM_NAME "qmi-device-bench"
+
+/* Requests are sent to a DMS client with a fixed CID; the fake modem
+ * answers anything it gets, so no CID needs to be allocated */
+#define BENCH_SERVICE    QMI_SERVICE_DMS
+#define BENCH_CID        1
+#define BENCH_MESSAGE_ID 0x0020
+
+#define FAKE_MODEM_BUFFER_SIZE 4096
+
+/* Options */
+static gint iterations = 10000;
+static gint n_devices = 8;
+
+static GOptionEntry main_entries[] = {
+    { "iterations", 'n', 0, G_OPTION_ARG_INT, &iterations,
+      "Number of commands, or rounds of commands, in each benchmark (default 10000)",
+      "[N]"
+    },
+    { "devices", 'd', 0, G_OPTION_ARG_INT, &n_devices,
+      "Number of fake modems driven by the device manager (default 8)",
+      "[N]"
+    },
+    { NULL }
+};
+
+/*****************************************************************************/
+/* Fake modem: the master side of a pty, answering every request with a
+ * successful response with just the result TLV */
+
+typedef struct {
+    gint master;
+    /* Kept open, so that the master doesn't report a hangup while the
+     * device has the slave closed */
+    gint slave;
+    gchar *path;
+    guint8 buffer[FAKE_MODEM_BUFFER_SIZE];
+    gsize len;
+} FakeModem;
+
+static FakeModem *
+fake_modem_new (GError **error)
+{
+    FakeModem *modem;
+    struct termios options;
+
+    modem = g_slice_new0 (FakeModem);
+    modem->slave = -1;
+
+    modem->master = posix_openpt (O_RDWR | O_NOCTTY);
+    if (modem->master < 0 ||
+        grantpt (modem->master) < 0 ||
+        unlockpt (modem->master) < 0) {
+        g_set_error (error,
+                     G_IO_ERROR,
+                     g_io_error_from_errno (errno),
+                     "Cannot create pty: %s",
+                     strerror (errno));
+        goto out;
+    }
+
+    modem->path = g_strdup (ptsname (modem->master));
+    modem->slave = open (modem->path, O_RDWR | O_NOCTTY);
+    if (modem->slave < 0) {
+        g_set_error (error,
+                     G_IO_ERROR,
+                     g_io_error_from_errno (errno),
+                     "Cannot open pty '%s': %s",
+                     modem->path,
+                     strerror (errno));
+        goto out;
+    }
+
+    /* QMUX frames are binary, no line discipline processing allowed */
+    tcgetattr (modem->slave, &options);
+    cfmakeraw (&options);
+    tcsetattr (modem->slave, TCSANOW, &options);
+
+    return modem;
+
+out:
+    if (modem->slave >= 0)
+        close (modem->slave);
+    if (modem->master >= 0)
+        close (modem->master);
+    g_free (modem->path);
+    g_slice_free (FakeModem, modem);
+    return NULL;
+}
+
+static void
+fake_modem_free (FakeModem *modem)
+{
+    close (modem->slave);
+    close (modem->master);
+    g_free (modem->path);
+    g_slice_free (FakeModem, modem);
+}
+
+static void
+fake_modem_reply (FakeModem *modem,
+                  const guint8 *request)
+{
+    guint8 reply[32];
+    gsize header_len;
+    gsize reply_len;
+
+    /* QMUX header plus CTL or service QMI header, up to the TLV length */
+    header_len = (request[4] == QMI_SERVICE_CTL) ? 10 : 11;
+    memcpy (reply, request, header_len);
+
+    /* Sent by the service, as a response */
+    reply[3] = 0x80;
+    reply[6] = (request[4] == QMI_SERVICE_CTL) ? 0x01 : 0x02;
+
+    /* Result TLV, all good */
+    reply[header_len] = 7;
+    reply[header_len + 1] = 0;
+    reply[header_len + 2] = 0x02;
+    reply[header_len + 3] = 4;
+    reply[header_len + 4] = 0;
+    memset (&reply[header_len + 5], 0, 4);
+
+    reply_len = header_len + 9;
+    reply[1] = (reply_len - 1) & 0xFF;
+    reply[2] = ((reply_len - 1) >> 8) & 0xFF;
+
+    if (write (modem->master, reply, reply_len) != (gssize)reply_len)
+        g_warning ("Couldn't write reply to '%s'", modem->path);
+}
+
+static void
+fake_modem_read (FakeModem *modem)
+{
+    gssize n_read;
+    gsize frame_len;
+
+    n_read = read (modem->master,
+                   &modem->buffer[modem->len],
+                   sizeof (modem->buffer) - modem->len);
+    if (n_read <= 0)
+        return;
+    modem->len += n_read;
+
+    while (modem->len >= 3) {
+        /* Skip garbage until the next marker */
+        if (modem->buffer[0] != QMI_MESSAGE_QMUX_MARKER) {
+            memmove (modem->buffer, &modem->buffer[1], --modem->len);
+            continue;
+        }
+
+        frame_len = 1 + (modem->buffer[1] | (modem->buffer[2] << 8));
+        if (frame_len > sizeof (modem->buffer)) {
+            modem->len = 0;
+            break;
+        }
+        if (modem->len < frame_len)
+            break;
+
+        if (frame_len >= 12)
+            fake_modem_reply (modem, modem->buffer);
+
+        modem->len -= frame_len;
+        memmove (modem->buffer, &modem->buffer[frame_len], modem->len);
+    }
+}
+
+/* All fake modems are served from a single thread, so that the main loop
+ * only runs the library side */
+typedef struct {
+    GPtrArray *modems;
+    gint wakeup[2];
+    GThread *thread;
+} FakeModemThread;
+
+static gpointer
+fake_modem_thread_func (FakeModemThread *ctx)
+{
+    struct pollfd *fds;
+    guint n_fds;
+    guint i;
+
+    n_fds = ctx->modems->len + 1;
+    fds = g_new0 (struct pollfd, n_fds);
+    for (i = 0; i < ctx->modems->len; i++) {
+        fds[i].fd = ((FakeModem *)g_ptr_array_index (ctx->modems, i))->master;
+        fds[i].events = POLLIN;
+    }
+    fds[ctx->modems->len].fd = ctx->wakeup[0];
+    fds[ctx->modems->len].events = POLLIN;
+
+    while (!fds[ctx->modems->len].revents) {
+        if (poll (fds, n_fds, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        for (i = 0; i < ctx->modems->len; i++) {
+            if (fds[i].revents & POLLIN)
+                fake_modem_read (g_ptr_array_index (ctx->modems, i));
+        }
+    }
+
+    g_free (fds);
+    return NULL;
+}
+
+static FakeModemThread *
+fake_modem_thread_start (guint n_modems,
+                         GError **error)
+{
+    FakeModemThread *ctx;
+    guint i;
+
+    ctx = g_slice_new0 (FakeModemThread);
+    ctx->modems = g_ptr_array_new_with_free_func ((GDestroyNotify)fake_modem_free);
+    for (i = 0; i < n_modems; i++) {
+        FakeModem *modem;
+
+        modem = fake_modem_new (error);
+        if (!modem) {
+            g_ptr_array_unref (ctx->modems);
+            g_slice_free (FakeModemThread, ctx);
+            return NULL;
+        }
+        g_ptr_array_add (ctx->modems, modem);
+    }
+
+    if (pipe (ctx->wakeup) < 0) {
+        g_set_error (error,
+                     G_IO_ERROR,
+                     g_io_error_from_errno (errno),
+                     "Cannot create pipe: %s",
+                     strerror (errno));
+        g_ptr_array_unref (ctx->modems);
+        g_slice_free (FakeModemThread, ctx);
+        return NULL;
+    }
+
+    ctx->thread = g_thread_new ("fake-modems",
+                                (GThreadFunc)fake_modem_thread_func,
+                                ctx);
+    return ctx;
+}
+
+static void
+fake_modem_thread_stop (FakeModemThread *ctx)
+{
+    if (write (ctx->wakeup[1], "", 1) != 1)
+        g_warning ("Couldn't stop fake modems");
+    g_thread_join (ctx->thread);
+    close (ctx->wakeup[0]);
+    close (ctx->wakeup[1]);
+    g_ptr_array_unref (ctx->modems);
+    g_slice_free (FakeModemThread, ctx);
+}
+
+static const gchar *
+fake_modem_thread_get_path (FakeModemThread *ctx,
+                            guint i)
+{
+    return ((FakeModem *)g_ptr_array_index (ctx->modems, i))->path;
+}
+
+/*****************************************************************************/
+/* Latency: one device, one command in flight at a time, with results
+ * completed in an idle or in the same dispatch that read them */
+
+typedef struct {
+    const gchar *name;
+    QmiDeviceOpenFlags flags;
+} LatencyMode;
+
+static const LatencyMode latency_modes[] = {
+    { "idle completion",   QMI_DEVICE_OPEN_FLAGS_NONE },
+    { "direct completion", QMI_DEVICE_OPEN_FLAGS_DIRECT_COMPLETION },
+};
+
+typedef struct {
+    GMainLoop *loop;
+    FakeModemThread *modems;
+    QmiDevice *device;
+    guint mode;
+    guint16 transaction_id;
+    gint remaining;
+    gint64 sent_time;
+    gint64 total_time;
+    gint64 max_time;
+    GError *error;
+} LatencyContext;
+
+static void latency_run_mode (LatencyContext *ctx);
+
+static void
+latency_command_ready (QmiDevice *device,
+                       GAsyncResult *res,
+                       LatencyContext *ctx);
+
+static void
+latency_send (LatencyContext *ctx)
+{
+    QmiMessage *message;
+
+    /* Transaction id 0 is never used */
+    if (++ctx->transaction_id == 0)
+        ctx->transaction_id = 1;
+
+    message = qmi_message_new (BENCH_SERVICE,
+                               BENCH_CID,
+                               ctx->transaction_id,
+                               BENCH_MESSAGE_ID);
+    ctx->sent_time = g_get_monotonic_time ();
+    qmi_device_command (ctx->device,
+                        message,
+                        5,
+                        NULL,
+                        (GAsyncReadyCallback)latency_command_ready,
+                        ctx);
+    qmi_message_unref (message);
+}
+
+static void
+latency_command_ready (QmiDevice *device,
+                       GAsyncResult *res,
+                       LatencyContext *ctx)
+{
+    QmiMessage *reply;
+    gint64 elapsed;
+
+    elapsed = g_get_monotonic_time () - ctx->sent_time;
+
+    reply = qmi_device_command_finish (device, res, &ctx->error);
+    if (!reply) {
+        g_main_loop_quit (ctx->loop);
+        return;
+    }
+    qmi_message_unref (reply);
+
+    ctx->total_time += elapsed;
+    ctx->max_time = MAX (ctx->max_time, elapsed);
+
+    if (--ctx->remaining > 0) {
+        latency_send (ctx);
+        return;
+    }
+
+    g_print ("%-18s %d commands, %.1f us average, %" G_GINT64_FORMAT " us max\n",
+             latency_modes[ctx->mode].name,
+             iterations,
+             (gdouble)ctx->total_time / iterations,
+             ctx->max_time);
+
+    if (!qmi_device_close (ctx->device, &ctx->error)) {
+        g_main_loop_quit (ctx->loop);
+        return;
+    }
+
+    if (++ctx->mode == G_N_ELEMENTS (latency_modes)) {
+        g_main_loop_quit (ctx->loop);
+        return;
+    }
+
+    latency_run_mode (ctx);
+}
+
+static void
+latency_open_ready (QmiDevice *device,
+                    GAsyncResult *res,
+                    LatencyContext *ctx)
+{
+    if (!qmi_device_open_finish (device, res, &ctx->error)) {
+        g_main_loop_quit (ctx->loop);
+        return;
+    }
+
+    ctx->remaining = iterations;
+    ctx->total_time = 0;
+    ctx->max_time = 0;
+    latency_send (ctx);
+}
+
+static void
+latency_run_mode (LatencyContext *ctx)
+{
+    qmi_device_open (ctx->device,
+                     latency_modes[ctx->mode].flags,
+                     5,
+                     NULL,
+                     (GAsyncReadyCallback)latency_open_ready,
+                     ctx);
+}
+
+static void
+latency_device_new_ready (GObject *source,
+                          GAsyncResult *res,
+                          LatencyContext *ctx)
+{
+    ctx->device = qmi_device_new_finish (res, &ctx->error);
+    if (!ctx->device) {
+        g_main_loop_quit (ctx->loop);
+        return;
+    }
+
+    latency_run_mode (ctx);
+}
+
+static gboolean
+run_latency (GError **error)
+{
+    LatencyContext ctx;
+    GFile *file;
+
+    memset (&ctx, 0, sizeof (ctx));
+    ctx.modems = fake_modem_thread_start (1, error);
+    if (!ctx.modems)
+        return FALSE;
+    ctx.loop = g_main_loop_new (NULL, FALSE);
+
+    file = g_file_new_for_path (fake_modem_thread_get_path (ctx.modems, 0));
+    qmi_device_new (file,
+                    NULL,
+                    (GAsyncReadyCallback)latency_device_new_ready,
+                    &ctx);
+    g_object_unref (file);
+
+    g_main_loop_run (ctx.loop);
+
+    if (ctx.device)
+        g_object_unref (ctx.device);
+    g_main_loop_unref (ctx.loop);
+    fake_modem_thread_stop (ctx.modems);
+
+    if (ctx.error) {
+        g_propagate_error (error, ctx.error);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/*****************************************************************************/
+/* Manager: the same command run on every fake modem at once, through a
+ * QmiDeviceManager sharing the main loop across all of them */
+
+typedef struct {
+    GMainLoop *loop;
+    FakeModemThread *modems;
+    QmiDeviceManager *manager;
+    guint16 transaction_id;
+    gint remaining;
+    guint failures;
+    gint64 start_time;
+    GError *error;
+} ManagerContext;
+
+static QmiMessage *
+manager_build_message (QmiDevice *device,
+                       ManagerContext *ctx)
+{
+    return qmi_message_new (BENCH_SERVICE,
+                            BENCH_CID,
+                            ctx->transaction_id,
+                            BENCH_MESSAGE_ID);
+}
+
+static void manager_command_ready (QmiDeviceManager *manager,
+                                   GAsyncResult *res,
+                                   ManagerContext *ctx);
+
+static void
+manager_send (ManagerContext *ctx)
+{
+    /* Same transaction id in every device, they don't share the table */
+    if (++ctx->transaction_id == 0)
+        ctx->transaction_id = 1;
+
+    qmi_device_manager_command (ctx->manager,
+                                (QmiDeviceManagerMessageFunc)manager_build_message,
+                                ctx,
+                                5000,
+                                NULL,
+                                (GAsyncReadyCallback)manager_command_ready,
+                                ctx);
+}
+
+static void
+manager_command_ready (QmiDeviceManager *manager,
+                       GAsyncResult *res,
+                       ManagerContext *ctx)
+{
+    GPtrArray *replies;
+    QmiDeviceStats stats;
+    gint64 elapsed;
+    guint i;
+
+    replies = qmi_device_manager_command_finish (manager, res, &ctx->error);
+    if (!replies) {
+        g_main_loop_quit (ctx->loop);
+        return;
+    }
+    for (i = 0; i < replies->len; i++) {
+        if (!g_ptr_array_index (replies, i))
+            ctx->failures++;
+    }
+    g_ptr_array_unref (replies);
+
+    if (--ctx->remaining > 0) {
+        manager_send (ctx);
+        return;
+    }
+
+    elapsed = g_get_monotonic_time () - ctx->start_time;
+    qmi_device_manager_get_stats (manager, &stats);
+
+    g_print ("%-18s %d devices, %d rounds, %.1f us per round, %.0f commands/s, %u failed\n",
+             "device manager",
+             n_devices,
+             iterations,
+             (gdouble)elapsed / iterations,
+             (gdouble)n_devices * iterations * G_USEC_PER_SEC / MAX (elapsed, 1),
+             ctx->failures);
+    g_print ("%-18s %" G_GUINT64_FORMAT " reads, %" G_GUINT64_FORMAT " writes, %" G_GUINT64_FORMAT " frames received\n",
+             "",
+             stats.read_syscalls,
+             stats.write_syscalls,
+             stats.frames_received);
+
+    qmi_device_manager_close (manager, &ctx->error);
+    g_main_loop_quit (ctx->loop);
+}
+
+static void
+manager_open_ready (QmiDeviceManager *manager,
+                    GAsyncResult *res,
+                    ManagerContext *ctx)
+{
+    if (!qmi_device_manager_open_finish (manager, res, &ctx->error)) {
+        g_main_loop_quit (ctx->loop);
+        return;
+    }
+
+    ctx->remaining = iterations;
+    ctx->start_time = g_get_monotonic_time ();
+    manager_send (ctx);
+}
+
+static gboolean
+run_manager (GError **error)
+{
+    ManagerContext ctx;
+    gchar **paths;
+    gint i;
+
+    memset (&ctx, 0, sizeof (ctx));
+    ctx.modems = fake_modem_thread_start (n_devices, error);
+    if (!ctx.modems)
+        return FALSE;
+    ctx.loop = g_main_loop_new (NULL, FALSE);
+    ctx.manager = qmi_device_manager_new ();
+
+    paths = g_new0 (gchar *, n_devices + 1);
+    for (i = 0; i < n_devices; i++)
+        paths[i] = g_strdup (fake_modem_thread_get_path (ctx.modems, i));
+
+    qmi_device_manager_open (ctx.manager,
+                             (const gchar * const *)paths,
+                             QMI_DEVICE_OPEN_FLAGS_NONE,
+                             5,
+                             NULL,
+                             (GAsyncReadyCallback)manager_open_ready,
+                             &ctx);
+    g_strfreev (paths);
+
+    g_main_loop_run (ctx.loop);
+
+    g_object_unref (ctx.manager);
+    g_main_loop_unref (ctx.loop);
+    fake_modem_thread_stop (ctx.modems);
+
+    if (ctx.error) {
+        g_propagate_error (error, ctx.error);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/*****************************************************************************/
+
+int main (int argc, char **argv)
+{
+    GError *error = NULL;
+    GOptionContext *context;
+
+    g_type_init ();
+
+    context = g_option_context_new ("- Benchmark QMI devices against fake modems");
+    g_option_context_add_main_entries (context, main_entries, NULL);
+    if (!g_option_context_parse (context, &argc, &argv, &error)) {
+        g_printerr ("error: %s\n", error->message);
+        exit (EXIT_FAILURE);
+    }
+    g_option_context_free (context);
+
+    if (iterations <= 0 || n_devices <= 0) {
+        g_printerr ("error: the number of iterations and devices must be positive\n");
+        exit (EXIT_FAILURE);
+    }
+
+    if (!run_latency (&error) ||
+        !run_manager (&error)) {
+        g_printerr ("error: %s\n", error->message);
+        g_error_free (error);
+        exit (EXIT_FAILURE);
+    }
+
+    return EXIT_SUCCESS;
+}